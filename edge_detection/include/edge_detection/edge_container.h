@@ -18,6 +18,20 @@ namespace edge_detection {
 
     using edge_idx      =  int;
 
+    /**
+    * @brief elevation map cells sampled to compute the step height of an edge, and the height measured on the last map.
+    * The height is stored for an edge normal that is not flipped towards the robot.
+    */
+    struct StepHeightCache {
+        bool valid = false;
+        int frame = -1;
+        Eigen::Vector2d point1_wf;
+        Eigen::Vector2d point2_wf;
+        std::vector<Eigen::Array2i> sample_indices; // (-1,-1) when the sample falls outside the map
+        double height;
+        double z;
+    };
+
     struct EdgeContainer {
         double length;
         double height;
@@ -26,6 +40,13 @@ namespace edge_detection {
         Eigen::Vector2d point1_wf;
         Eigen::Vector2d point2_wf;
         Eigen::Vector2d line_coeffs;
+        Eigen::Matrix2d rotation; // odom frame to edge-aligned frame, precomputed from the yaw angle
+        StepHeightCache height_cache;
+        int id;                   // stable identifier, kept as long as the edge is tracked
+        int hits;                 // number of frames in which the edge was detected
+        int last_seen_frame;
+        double last_seen;         // time stamp (s) of the map in which the edge was last detected
+        double signed_distance;   // distance from the robot, refreshed when the edge or the robot moves
     };
 } /* namespace edge_detection */
 
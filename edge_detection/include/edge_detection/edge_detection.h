@@ -11,21 +11,63 @@
 #define EDGE_DETECTION_EDGE_DETECTION_H
 
 #include <grid_map_core/grid_map_core.hpp>
-#include <grid_map_ros/grid_map_ros.hpp>
+#include <opencv2/core/core.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <edge_detection/edge_container.h>
+#include <edge_detection/edge_grid_index.h>
 
 namespace edge_detection {
 
     class EdgeDetection {
     public:
 
-        EdgeDetection(ros::NodeHandle & node_handle, std::string & frame_name, double & min_length, double & min_height);
+        /**
+        * @brief region of the elevation map searched for new edges: whole map, window centered on the robot, or ellipse along the robot's heading
+        */
+        enum class RoiMode {NONE, WINDOW, ELLIPSE};
+
+        /**
+        * @brief external source of step heights (e.g. the planes of a segmentation of the same map). Given the two corners of an edge
+        * and its normal (pointing along the robot's heading) it returns false if it cannot tell, or the height of the step
+        * (z ahead minus z behind the edge) and the z coordinate of the upper side.
+        */
+        typedef std::function<bool(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf, const Eigen::Vector2d & edge_normal,
+                double & height, double & z_coordinate)> StepHeightProvider;
+
+        /**
+        * @brief wall-clock time (ms) spent in the stages of the last call to advance. The image stage covers the conversion
+        * of the map and the region of interest.
+        */
+        struct Timings {
+            double image = 0.0;
+            double blur = 0.0;
+            double canny = 0.0;
+            double hough = 0.0;
+            double check_existing_edges = 0.0;
+            double find_new_edges = 0.0;
+            double total = 0.0;
+        };
+
+        EdgeDetection(const std::string & frame_name, const double & min_length, const double & min_height);
         virtual ~EdgeDetection();
 
         /**
-        * @brief update list of detected edges
+        * @brief update list of detected edges. The map is only read, so it can be shared with other consumers.
+        */
+        bool advance(const Eigen::Vector3d & base_pose_so2, const std::shared_ptr<const grid_map::GridMap> & map);
+
+        /**
+        * @brief update list of detected edges with candidate edges found by other means (e.g. PlaneEdgeExtractor) instead of the image pipeline.
+        * The corners, height and z of the candidates are used as measured (the height oriented as for the edges found on the image),
+        * the other fields are set here.
         */
-        bool advance(const Eigen::Vector3d & base_pose_so2, const grid_map_msgs::GridMap & message);
+        bool advance(const Eigen::Vector3d & base_pose_so2, const std::shared_ptr<const grid_map::GridMap> & map,
+                const std::vector<EdgeContainer> & candidates);
 
         /**
         * @brief get perpendicular distance between robot's odometry frame and the considered edge.
@@ -52,18 +94,75 @@ namespace edge_detection {
         */
         int numberOfDetectedEdges();
 
+        /**
+        * @brief restrict the search for new edges to a region around the robot, cropped before any image filtering.
+        * The region extends "radius" meters from the robot, plus "speed_gain" seconds times the robot's speed, up to "max_radius".
+        * In ellipse mode only the extent along the robot's heading grows with the speed.
+        */
+        void setRegionOfInterest(const RoiMode & mode, const double & radius, const double & speed_gain, const double & max_radius);
+
+        /**
+        * @brief evict the tracked edges not detected for "max_age" seconds or further than "max_distance" from the robot,
+        * and keep at most "max_edges" of them (the most recently detected ones). Eviction is disabled by default: a
+        * "max_age" or "max_distance" of 0 and a negative "max_edges" keep the edges regardless of their age, distance and number.
+        */
+        void setEdgeLifetime(const double & max_age, const double & max_distance, const int & max_edges);
+
+        /**
+        * @brief a re-detected edge is updated with gain max(1/hits, min_gain). Edges are confirmed after "min_hits" detections.
+        */
+        void setEdgeFilter(const double & min_gain, const int & min_hits);
+
+        /**
+        * @brief only order the "number_of_edges" edges closest to the robot (plus the confirmed ones before the others); 0 orders all the edges.
+        */
+        void setNumberOfSortedEdges(const int & number_of_edges);
+
+        /**
+        * @brief run the Hough transform on square tiles of "tile_size" pixels (overlapping by "overlap" pixels) using "number_of_threads" workers.
+        * Segments cut by the tile borders are stitched back together. A tile size of 0 processes the whole image at once.
+        */
+        void setHoughTiling(const int & tile_size, const int & overlap, const int & number_of_threads);
+
+        /**
+        * @brief query "provider" for the step heights before sampling the elevation map. An empty function disables it.
+        */
+        void setStepHeightProvider(const StepHeightProvider & provider);
+
+        /**
+        * @brief get the time spent in each stage of the last update.
+        */
+        const Timings & getTimings() const;
+
+        /**
+        * @brief enable or disable writing the intermediate images (image.png, edge_filtered.png, edge_edges.png) at each update.
+        */
+        void setDebugImages(const bool & write_images);
+
+        /**
+        * @brief get the stable identifier of the idx-th edge.
+        */
+        int getEdgeId(edge_idx idx);
+
+        /**
+        * @brief check whether the idx-th edge has been detected often enough to be published.
+        */
+        bool isEdgeConfirmed(edge_idx idx);
+
         /**
         * @brief use list of ground truth edges (for debugging)
         */
         void setFakeEdges(const Eigen::Vector3d & base_pose);
 
         /**
-        * @brief get height of the idx-th step in the array of stored edges (from closest to the robot to the furthest).
+        * @brief get height of the idx-th step in the array of stored edges. Only the first ones (see setNumberOfSortedEdges)
+        * are ordered from closest to the robot to the furthest.
         */
         double getStepHeight(edge_idx idx);
 
         /**
-        * @brief go through the output of the Hough transform and select new edges
+        * @brief select the edge closest to the robot (confirmed edges first), from the first unchanged sorted edge
+        * and the edges changed or added since the sorting
         */
         edge_idx findNextEdge();
 
@@ -81,11 +180,68 @@ namespace edge_detection {
 
     private:
 
+        typedef std::chrono::steady_clock Clock;
+
+        /**
+        * @brief threads kept between frames to run the Hough transform on the tiles. Each task is run by all the workers
+        * and by the calling thread, which waits for them to finish.
+        */
+        struct HoughWorkerPool {
+            std::vector<std::thread> workers;
+            std::mutex mutex;
+            std::condition_variable start;
+            std::condition_variable done;
+            std::function<void()> task;
+            int generation = 0;
+            int running = 0;
+            bool stop = false;
+        };
+
+        /**
+        * @brief body of the threads of the Hough worker pool, which run the tasks posted after "generation"
+        */
+        void houghWorkerLoop(int generation);
+
+        /**
+        * @brief run "task" on every worker of the pool and on the calling thread, and wait for all of them
+        */
+        void runOnHoughWorkers(const std::function<void()> & task);
+
+        /**
+        * @brief join the threads of the Hough worker pool
+        */
+        void stopHoughWorkers();
+
+        /**
+        * @brief get the time elapsed since "stage_start" (ms) and restart it
+        */
+        double elapsedMilliseconds(Clock::time_point & stage_start);
+
         /**
         * @brief convert the positions on the image to positions in the odom frame
         */
         Eigen::Vector2d convertImageToOdomFrame(const double & resolution, const Eigen::Array2i & grid_size, const int & p_x, const int & p_y);
 
+        /**
+        * @brief convert a position in the odom frame to (fractional) pixel coordinates on the image (inverse of convertImageToOdomFrame)
+        */
+        Eigen::Vector2d convertOdomToImageFrame(const double & resolution, const Eigen::Array2i & grid_size, const Eigen::Vector2d & p_wf);
+
+        /**
+        * @brief estimate the speed of the robot from the base pose and the time stamp of the last two maps
+        */
+        void updateRobotSpeed(const Eigen::Vector3d & base_pose);
+
+        /**
+        * @brief get the image region containing the region of interest around the robot (padded for the median filter)
+        */
+        cv::Rect computeRegionOfInterest(const int & rows, const int & cols);
+
+        /**
+        * @brief remove the edge pixels outside of the elliptic region of interest
+        */
+        void maskRegionOfInterest(cv::Mat & im_edges, const cv::Rect & roi);
+
         /**
         * @brief get horizontal lenght of an edge given the two corners.
         */
@@ -102,45 +258,118 @@ namespace edge_detection {
         double computeStepHeight(const Eigen::Vector2d & p1_bf, const Eigen::Vector2d & p2_bf, double & z_coordinate);
 
         /**
-        * @brief get z coordinate of a candidate edge and the height of the step.
+        * @brief ask the step height provider, if any, for the height of the step and the z coordinate of the upper side.
+        */
+        bool getProvidedStepHeight(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf, double & height, double & z_coordinate);
+
+        /**
+        * @brief get height of the step under a stored edge, sampled once per map. The indices of the sampled cells are reused until the map moves.
+        */
+        double updateStepHeight(EdgeContainer & edge);
+
+        /**
+        * @brief compute the indices of the cells sampled on both sides of an edge (two per sample: ahead and behind the edge)
+        */
+        void computeSampleIndices(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf, std::vector<grid_map::Index> & indices);
+
+        /**
+        * @brief read the sampled cells directly from the elevation matrix and get the step height (for a normal not flipped towards the robot).
+        */
+        double sampleStepHeight(const std::vector<grid_map::Index> & indices, double & z_coordinate);
+
+        /**
+        * @brief get +1 if the edge normal is aligned with the robot's heading, -1 otherwise.
+        */
+        double computeNormalSign(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf);
+
+        /**
+        * @brief start a new frame and record whether the map moved or changed geometry since the previous one
         */
-        double computeHeight(const Eigen::Vector2d & edge_normal, const Eigen::Vector2d & point2check, double & z_coordinate);
+        void updateMapState();
 
         /**
         * @brief check whether the considered point "p" is inside an ellipse centered in "ellipse_center" and oriented a "yaw", with upper and lower diagonals "d1" and "d2"
         */
         bool isInsideEllipse(const double & yaw, const Eigen::Vector2d & ellipse_center, const Eigen::Vector2d & p, const double & d1, const double & d2);
 
+        /**
+        * @brief same as above, using the rotation precomputed for the ellipse orientation (see setEdgeYaw)
+        */
+        bool isInsideEllipse(const Eigen::Matrix2d & rotation, const Eigen::Vector2d & ellipse_center, const Eigen::Vector2d & p, const double & d1, const double & d2);
+
+        /**
+        * @brief set yaw angle of an edge together with the quantities derived from it (line coefficients and rotation)
+        */
+        void setEdgeYaw(EdgeContainer & edge, const double & yaw);
+
         /**
         * @brief get z coordinate on the elevation map given the (x,y) coordinates
         */
         double GetHeight(double & x, double & y);
 
         /**
-        * @brief check if the given edge corresponds to an already existing edge
+        * @brief check if the given edge corresponds to an already existing edge. If "measured" is given, its height and z
+        * are merged into the existing edge instead of measuring the step at the merged position.
         */
-        bool isEdgeRedundant(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf);
+        bool isEdgeRedundant(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf, const EdgeContainer * measured = nullptr);
 
         /**
         * @brief check if the given edge is within a desired angle range w.r.t. the robot
         */
         bool isEdgeFacingRobot(const double & edge_yaw_wf, const double & robot_yaw_angle);
 
+        /**
+        * @brief run the probabilistic Hough transform on the edge image of the region "roi", on parallel tiles if enabled.
+        * The lines are returned in the coordinates of the full image.
+        */
+        void detectLines(const cv::Mat & im_edges, const cv::Rect & roi, std::vector<cv::Vec4i> & lines);
+
+        /**
+        * @brief merge the collinear segments found by neighbouring tiles in the bands they share (tiles and lines in full image coordinates)
+        */
+        void stitchTileLines(const cv::Rect & roi, const std::vector<cv::Rect> & tiles, const std::vector<std::vector<cv::Vec4i>> & tile_lines, std::vector<cv::Vec4i> & lines);
+
         /**
         * @brief check the output of the Hough transform to see if there is any edge/line
         */
         void findNewEdges(const std::vector<cv::Vec4i> & lines, const Eigen::Vector3d & base_pose_so2);
 
+        /**
+        * @brief store a candidate edge if it is long and high enough and not redundant with an existing edge.
+        * If "measured" is true, the height and z of the candidate are kept instead of being measured on the map.
+        */
+        void addNewEdge(EdgeContainer & new_edge, const edge_idx & candidate_idx, const bool & measured = false);
+
+        /**
+        * @brief select the edge closest to the robot
+        */
+        void updateNextEdge();
+
         /**
         * @brief double check the list of existing edges to check if some parameters have changed (useful for initially occluded zones)
         */
         void checkExistingEdges(const Eigen::Vector3d & base_pose);
 
+        /**
+        * @brief remove the edges that are too old or too far from the robot, and bound the number of tracked edges
+        */
+        void evictEdges(const Eigen::Vector3d & base_pose);
+
+        /**
+        * @brief refresh the distance between the robot and the given edge
+        */
+        void updateEdgeDistance(EdgeContainer & edge);
+
         /**
         * @brief sort edges according to their relative distance to the robot
         */
         void sortEdgesFromClosestToFurthest(const Eigen::Vector3d & base_pose);
 
+        /**
+        * @brief order used by the sorting: confirmed edges first, then by distance to the robot
+        */
+        bool isCloserEdge(const EdgeContainer & a, const EdgeContainer & b);
+
         /**
         * @brief compare how similar are two given edges given their line coefficients (a*x + b*y = c)
         */
@@ -165,9 +394,8 @@ namespace edge_detection {
         double computeDistanceBtwEdgeAndBaseInWorldFrame(const Eigen::Vector2d & p1_bf, const Eigen::Vector2d & p2_bf, const Eigen::Vector2d & base_pos);
         double computeSignedDistanceBtwEdgeAndBaseInWorldFrame(const Eigen::Vector2d & p1_bf, const Eigen::Vector2d & p2_bf, const Eigen::Vector2d & base_pos);
 
-        grid_map::GridMap gridMap_;
+        std::shared_ptr<const grid_map::GridMap> gridMap_;
         double deltaFiniteDifferentiation_;
-        ros::NodeHandle node_handle_;
         std::vector<cv::Vec4i> linesP_; // will hold the results of the detection
         Eigen::Vector2d edge_direction_;
         Eigen::Vector2d middle_point_;
@@ -178,6 +406,42 @@ namespace edge_detection {
         double max_height_;
         std::vector<edge_idx> orthogonal_edge_indices_;
         Eigen::Vector3d base_pose_;
+        EdgeGridIndex edge_index_;
+        const grid_map::Matrix * elevation_;
+        double previous_resolution_;
+        grid_map::Size previous_size_;
+        grid_map::Position previous_map_position_;
+        grid_map::Index previous_start_index_;
+        int frame_count_;
+        int map_change_frame_; // last frame in which the map moved or changed geometry
+        std::vector<grid_map::Index> sample_indices_;
+        RoiMode roi_mode_;
+        double roi_radius_;
+        double roi_speed_gain_;
+        double roi_max_radius_;
+        double robot_speed_;
+        double previous_stamp_;
+        Eigen::Vector3d previous_base_pose_;
+        double current_stamp_;
+        int next_edge_id_;
+        double max_edge_age_;
+        double max_edge_distance_;
+        int max_edges_;
+        double edge_filter_min_gain_;
+        int min_hits_;
+        int number_of_sorted_edges_;
+        size_t sorted_edges_end_;            // edges added after this index have not been sorted yet
+        std::vector<edge_idx> changed_sorted_edges_; // sorted edges updated by a redundant detection since the sorting
+        Eigen::Vector2d distances_base_pos_; // robot position for which the edge distances were refreshed
+        int hough_tile_size_;
+        int hough_tile_overlap_;
+        int hough_threads_;
+        HoughWorkerPool hough_pool_;
+        double redundancy_search_radius_;
+        std::vector<edge_idx> nearby_edges_;
+        StepHeightProvider step_height_provider_;
+        Timings timings_;
+        bool write_debug_images_;
 
 
     }; //end class EdgeDetection
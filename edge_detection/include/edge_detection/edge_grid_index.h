@@ -0,0 +1,76 @@
+/**
+ * @file edge_grid_index.h
+ * @brief Uniform grid over the endpoints of the stored edges, used to look up the edges close to a candidate
+ * @author Romeo Orsolino (rorsolino@robots.ox.ac.uk)
+ * @bug No known bugs.
+ * @date 17/10/2026
+ * @version 1.0
+ * @copyright 2020, Romeo Orsolino. BSD-3-Clause
+ */
+#ifndef EDGE_DETECTION_EDGE_GRID_INDEX_H
+#define EDGE_DETECTION_EDGE_GRID_INDEX_H
+
+#include <Eigen/Core>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <edge_detection/edge_container.h>
+
+namespace edge_detection {
+
+    class EdgeGridIndex {
+    public:
+
+        explicit EdgeGridIndex(const double & cell_size = 0.5);
+
+        /**
+        * @brief set the side of the square cells (in meters). Clears the index.
+        */
+        void setCellSize(const double & cell_size);
+
+        /**
+        * @brief remove all the edges from the index.
+        */
+        void clear();
+
+        /**
+        * @brief re-index the whole list of edges (to be called after the list is filtered or reordered).
+        */
+        void build(const std::vector<EdgeContainer> & edges);
+
+        /**
+        * @brief add the idx-th edge of the list to the index.
+        */
+        void insert(const edge_idx & idx, const EdgeContainer & edge);
+
+        /**
+        * @brief move the idx-th edge to the cells of its (possibly changed) endpoints.
+        */
+        void update(const edge_idx & idx, const EdgeContainer & edge);
+
+        /**
+        * @brief collect the indices of the edges having at least one endpoint in the cells overlapping
+        * the bounding box of the segment p1-p2 inflated by "radius". Each index is returned once.
+        */
+        void query(const Eigen::Vector2d & p1, const Eigen::Vector2d & p2, const double & radius, std::vector<edge_idx> & candidates);
+
+    private:
+
+        using CellKey = int64_t;
+
+        CellKey computeKey(const int & ix, const int & iy) const;
+        CellKey computeKey(const Eigen::Vector2d & p) const;
+        void remove(const edge_idx & idx);
+
+        double cell_size_;
+        std::unordered_map<CellKey, std::vector<edge_idx>> cells_;
+        std::vector<std::array<CellKey, 2>> edge_keys_;
+        std::vector<unsigned int> query_stamps_;
+        unsigned int current_stamp_;
+
+    }; //end class EdgeGridIndex
+
+} //end namespace
+
+#endif //EDGE_DETECTION_EDGE_GRID_INDEX_H
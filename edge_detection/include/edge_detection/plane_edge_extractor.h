@@ -0,0 +1,106 @@
+/**
+ * @file plane_edge_extractor.h
+ * @brief Geometric detector of step edges at the boundaries between adjacent horizontal planar segments
+ * @author Romeo Orsolino (rorsolino@robots.ox.ac.uk)
+ * @bug No known bugs.
+ * @date 17/10/2026
+ * @version 1.0
+ * @copyright 2020, Romeo Orsolino. BSD-3-Clause
+ */
+#ifndef EDGE_DETECTION_PLANE_EDGE_EXTRACTOR_H
+#define EDGE_DETECTION_PLANE_EDGE_EXTRACTOR_H
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <edge_detection/edge_container.h>
+
+namespace edge_detection {
+
+    /**
+    * @brief planar region of the terrain (e.g. a block of the plane segmentation): the corners of its convex hull
+    * in the odom frame and the coefficients (a, b, c, d) of its plane a*x + b*y + c*z + d = 0.
+    */
+    struct PlanarSegment {
+        std::vector<Eigen::Vector2d> hull;
+        Eigen::Vector4d plane;
+    };
+
+    class PlaneEdgeExtractor {
+    public:
+
+        PlaneEdgeExtractor();
+
+        /**
+        * @brief set the segments to intersect. Only the segments whose unit normal has a z component of at least
+        * "min_normal_z" are kept (the default keeps the ones tilted by less than ~37 deg).
+        */
+        void setSegments(const std::vector<PlanarSegment> & segments, const double & min_normal_z = 0.8);
+
+        /**
+        * @brief two hull sides make an edge if they are within "max_gap" meters and "max_angle" radians of each other,
+        * overlap for at least "min_length" meters and the planes are at least "min_height" meters apart.
+        * Edges longer than "max_length" are split into equal pieces.
+        */
+        void setThresholds(const double & min_length, const double & max_length, const double & min_height,
+                const double & max_gap, const double & max_angle);
+
+        /**
+        * @brief get the edges between adjacent segments, to be passed to EdgeDetection::advance. Only the corners, length,
+        * height and z of the edges are set. As for the image based detector, the height is positive for steps going up
+        * along the heading of the robot at "base_pose" and z is the height of the upper side.
+        */
+        void extract(const Eigen::Vector3d & base_pose, std::vector<EdgeContainer> & edges);
+
+        /**
+        * @brief get the height of the step under an edge from the planes of the segments on both sides of it
+        * (same signature as EdgeDetection::StepHeightProvider). Returns false if a side is not covered by any segment.
+        */
+        bool getStepHeight(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf, const Eigen::Vector2d & edge_normal,
+                double & height, double & z_coordinate) const;
+
+        /**
+        * @brief get the z coordinate of the highest segment containing the point p. Only the segments whose
+        * bounding box overlaps the cell of p are tested.
+        */
+        bool getHeight(const Eigen::Vector2d & p, double & z) const;
+
+    private:
+
+        using CellKey = int64_t;
+
+        CellKey computeKey(const int & ix, const int & iy) const;
+
+        /**
+        * @brief add each segment to the cells of the uniform grid overlapped by its bounding box
+        */
+        void buildIndex();
+
+        /**
+        * @brief z coordinate of the plane of the idx-th segment above the point p
+        */
+        double getPlaneHeight(const size_t & idx, const Eigen::Vector2d & p) const;
+
+        /**
+        * @brief add the pieces of the edge between p1 and p2, separating the segments "first" and "second"
+        */
+        void addEdge(const Eigen::Vector2d & p1, const Eigen::Vector2d & p2, const size_t & first, const size_t & second,
+                const Eigen::Vector3d & base_pose, std::vector<EdgeContainer> & edges);
+
+        std::vector<PlanarSegment> segments_;
+        std::vector<Eigen::Vector2d> centroids_;
+        std::unordered_map<CellKey, std::vector<size_t>> cells_;
+        double min_length_;
+        double max_length_;
+        double min_height_;
+        double max_gap_;
+        double max_angle_;
+        double cell_size_;
+        double sampling_offset_;
+
+    }; //end class PlaneEdgeExtractor
+
+} //end namespace
+
+#endif //EDGE_DETECTION_PLANE_EDGE_EXTRACTOR_H
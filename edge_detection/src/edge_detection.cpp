@@ -5,21 +5,55 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <grid_map_cv/GridMapCvConverter.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <limits>
 #include <numeric>
-
-#include <ros/ros.h>
+#include <thread>
 
 namespace edge_detection {
 
-    EdgeDetection::EdgeDetection (ros::NodeHandle& node_handle, std::string & frame_name, double & min_length, double & min_height):
-    node_handle_(node_handle),
+    EdgeDetection::EdgeDetection (const std::string & frame_name, const double & min_length, const double & min_height):
+    gridMap_(std::make_shared<grid_map::GridMap>()),
     min_length_(min_length),
-    min_height_(min_height)
+    min_height_(min_height),
+    elevation_(nullptr),
+    previous_resolution_(0.0),
+    previous_size_(0, 0),
+    frame_count_(0),
+    map_change_frame_(0),
+    roi_mode_(RoiMode::NONE),
+    roi_radius_(1.5),
+    roi_speed_gain_(0.0),
+    roi_max_radius_(1.5),
+    robot_speed_(0.0),
+    previous_stamp_(0.0),
+    current_stamp_(0.0),
+    next_edge_id_(0),
+    max_edge_age_(0.0),
+    max_edge_distance_(0.0),
+    max_edges_(-1),
+    edge_filter_min_gain_(0.2),
+    min_hits_(1),
+    number_of_sorted_edges_(0),
+    sorted_edges_end_(0),
+    distances_base_pos_(Eigen::Vector2d::Constant(std::numeric_limits<double>::quiet_NaN())),
+    hough_tile_size_(0),
+    hough_tile_overlap_(10),
+    hough_threads_(1),
+    write_debug_images_(true)
     {
 
       max_height_ = 10.0;
       max_length_ = 1.5;
       frame_name_ = frame_name;
+      // an existing edge long up to max_length_ overlapping a candidate has an endpoint within
+      // max_length_/2 of it, plus the minor axis of the ellipses used in isEdgeRedundant
+      redundancy_search_radius_ = max_length_/2.0 + 0.2;
+      edge_index_.setCellSize(redundancy_search_radius_);
       std::cout<<"[EdgeDetection::detectEdges] Parameters: "<<std::endl;
       std::cout<<"[EdgeDetection::detectEdges] min length: "<<min_length_<<std::endl;
       std::cout<<"[EdgeDetection::detectEdges] max length: "<<max_length_<<std::endl;
@@ -30,41 +64,127 @@ namespace edge_detection {
 
     EdgeDetection::~EdgeDetection()
     {
+      stopHoughWorkers();
     }
 
-    bool EdgeDetection::advance(const Eigen::Vector3d & base_pose, const grid_map_msgs::GridMap & message){
-      grid_map::GridMapRosConverter::fromMessage(message, gridMap_);
+    bool EdgeDetection::advance(const Eigen::Vector3d & base_pose, const std::shared_ptr<const grid_map::GridMap> & map){
+      Clock::time_point start = Clock::now();
+      Clock::time_point stage_start = start;
+      timings_ = Timings();
+
+      gridMap_ = map;
+      updateMapState();
 
       cv::Mat image, im_edges, image_filtered;
       grid_map::GridMapCvConverter::toImage<unsigned char, 1>(
-              gridMap_, "elevation", CV_8UC1, image);
+              *gridMap_, "elevation", CV_8UC1, image);
 
       // Check if image is loaded fine
       if(image.empty()){
         printf(" Error opening image\n");
       }
 
-      cv::medianBlur(image, image_filtered, 11);
-      // Edge detection
-      cv::Canny(image_filtered, im_edges, 50, 20, 3);
+      base_pose_ = base_pose;
+      updateRobotSpeed(base_pose);
+
+      // only filter the part of the image around the robot
+      cv::Rect roi(0, 0, image.cols, image.rows);
+      if(roi_mode_ != RoiMode::NONE){
+        roi = computeRegionOfInterest(image.rows, image.cols);
+      }
+      timings_.image = elapsedMilliseconds(stage_start);
+
       // Standard Hough Line Transform
       std::vector<cv::Vec4i> lines; // will hold the results of the detection
-      //cv::HoughLines(im_edges, lines, 1, CV_PI/180, 150, 0, 0 ); // runs the actual detection
-
-      // Probabilistic Line Transform
-      HoughLinesP(im_edges, lines, 1, CV_PI/180, 5, 5, 5 ); // runs the actual detection
+      if(roi.area() > 0){
+        cv::medianBlur(image(roi), image_filtered, 11);
+        timings_.blur = elapsedMilliseconds(stage_start);
+        // Edge detection
+        cv::Canny(image_filtered, im_edges, 50, 20, 3);
+        if(roi_mode_ == RoiMode::ELLIPSE){
+          maskRegionOfInterest(im_edges, roi);
+        }
+        timings_.canny = elapsedMilliseconds(stage_start);
+        //cv::HoughLines(im_edges, lines, 1, CV_PI/180, 150, 0, 0 ); // runs the actual detection
 
-      imwrite("image.png",image);
-      imwrite("edge_edges.png",im_edges);
-      imwrite("edge_filtered.png",image_filtered);
+        // Probabilistic Line Transform
+        detectLines(im_edges, roi, lines); // runs the actual detection
+        timings_.hough = elapsedMilliseconds(stage_start);
 
-      base_pose_ = base_pose;
+        if(write_debug_images_){
+          imwrite("edge_edges.png",im_edges);
+          imwrite("edge_filtered.png",image_filtered);
+        }
+      }
+      if(write_debug_images_){
+        imwrite("image.png",image);
+      }
+      stage_start = Clock::now();
 
       checkExistingEdges(base_pose);
+      timings_.check_existing_edges = elapsedMilliseconds(stage_start);
 
       findNewEdges(lines, base_pose);
       //setFakeEdges();
+      timings_.find_new_edges = elapsedMilliseconds(stage_start);
 
+      updateNextEdge();
+      timings_.total = elapsedMilliseconds(start);
+
+      return true;
+    }
+
+    bool EdgeDetection::advance(const Eigen::Vector3d & base_pose,
+            const std::shared_ptr<const grid_map::GridMap> & map,
+            const std::vector<EdgeContainer> & candidates){
+      Clock::time_point start = Clock::now();
+      Clock::time_point stage_start = start;
+      timings_ = Timings();
+
+      gridMap_ = map;
+      updateMapState();
+
+      base_pose_ = base_pose;
+      updateRobotSpeed(base_pose);
+      stage_start = Clock::now();
+
+      checkExistingEdges(base_pose);
+      timings_.check_existing_edges = elapsedMilliseconds(stage_start);
+
+      orthogonal_edge_indices_.clear();
+      for( size_t i = 0; i < candidates.size(); i++ ){
+        // the candidates go through the same checks as the lines found on the image, with the heights they come with
+        EdgeContainer new_edge;
+        new_edge.point1_wf = candidates.at(i).point1_wf;
+        new_edge.point2_wf = candidates.at(i).point2_wf;
+        new_edge.height = candidates.at(i).height;
+        new_edge.z = candidates.at(i).z;
+        addNewEdge(new_edge, i, true);
+      }
+      timings_.find_new_edges = elapsedMilliseconds(stage_start);
+
+      updateNextEdge();
+      timings_.total = elapsedMilliseconds(start);
+
+      return true;
+    }
+
+    double EdgeDetection::elapsedMilliseconds(Clock::time_point & stage_start){
+      Clock::time_point now = Clock::now();
+      double elapsed = std::chrono::duration<double, std::milli>(now - stage_start).count();
+      stage_start = now;
+      return elapsed;
+    }
+
+    const EdgeDetection::Timings & EdgeDetection::getTimings() const{
+      return timings_;
+    }
+
+    void EdgeDetection::setDebugImages(const bool & write_images){
+      write_debug_images_ = write_images;
+    }
+
+    void EdgeDetection::updateNextEdge(){
       findNextEdge();
 
       std::cout<<"[EdgeDetection::advance] number of detected edges: "<<edges_.size()<<std::endl;
@@ -73,14 +193,344 @@ namespace edge_detection {
         EdgeContainer next_edge = edges_.at(closest_orthogonal_edge_index_);
         edge_direction_ = next_edge.line_coeffs;
       }
+    }
 
-      return true;
+    void EdgeDetection::setRegionOfInterest(const RoiMode & mode, const double & radius, const double & speed_gain, const double & max_radius){
+      roi_mode_ = mode;
+      roi_radius_ = radius;
+      roi_speed_gain_ = speed_gain;
+      roi_max_radius_ = std::max(radius, max_radius);
+      std::cout<<"[EdgeDetection::setRegionOfInterest] mode: "<<(int)roi_mode_<<", radius: "<<roi_radius_
+               <<", speed gain: "<<roi_speed_gain_<<", max radius: "<<roi_max_radius_<<std::endl;
+    }
+
+    void EdgeDetection::setEdgeLifetime(const double & max_age, const double & max_distance, const int & max_edges){
+      max_edge_age_ = max_age;
+      max_edge_distance_ = max_distance;
+      max_edges_ = max_edges;
+    }
+
+    void EdgeDetection::setEdgeFilter(const double & min_gain, const int & min_hits){
+      edge_filter_min_gain_ = min_gain;
+      min_hits_ = min_hits;
+    }
+
+    void EdgeDetection::setStepHeightProvider(const StepHeightProvider & provider){
+      step_height_provider_ = provider;
+    }
+
+    void EdgeDetection::setHoughTiling(const int & tile_size, const int & overlap, const int & number_of_threads){
+      hough_tile_size_ = tile_size;
+      hough_tile_overlap_ = std::max(overlap, 0);
+      hough_threads_ = std::max(number_of_threads, 1);
+      std::cout<<"[EdgeDetection::setHoughTiling] tile size: "<<hough_tile_size_<<", overlap: "<<hough_tile_overlap_
+               <<", threads: "<<hough_threads_<<std::endl;
+
+      // the calling thread is one of the workers
+      stopHoughWorkers();
+      if(hough_tile_size_ > 0){
+        // the new workers only wait for the tasks posted after this point
+        std::lock_guard<std::mutex> lock(hough_pool_.mutex);
+        hough_pool_.stop = false;
+        for(int i = 1; i < hough_threads_; i++){
+          hough_pool_.workers.emplace_back(&EdgeDetection::houghWorkerLoop, this, hough_pool_.generation);
+        }
+      }
+    }
+
+    void EdgeDetection::stopHoughWorkers(){
+      {
+        std::lock_guard<std::mutex> lock(hough_pool_.mutex);
+        hough_pool_.stop = true;
+      }
+      hough_pool_.start.notify_all();
+      for(size_t i = 0; i < hough_pool_.workers.size(); i++){
+        hough_pool_.workers[i].join();
+      }
+      hough_pool_.workers.clear();
+      // the last task refers to a finished frame
+      std::lock_guard<std::mutex> lock(hough_pool_.mutex);
+      hough_pool_.task = nullptr;
+      hough_pool_.running = 0;
+    }
+
+    void EdgeDetection::houghWorkerLoop(int generation){
+      while(true){
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(hough_pool_.mutex);
+          hough_pool_.start.wait(lock, [&](){ return hough_pool_.stop || (hough_pool_.generation != generation); });
+          if(hough_pool_.stop){
+            return;
+          }
+          generation = hough_pool_.generation;
+          task = hough_pool_.task;
+        }
+        task();
+        {
+          std::lock_guard<std::mutex> lock(hough_pool_.mutex);
+          if(--hough_pool_.running == 0){
+            hough_pool_.done.notify_all();
+          }
+        }
+      }
+    }
+
+    void EdgeDetection::runOnHoughWorkers(const std::function<void()> & task){
+      {
+        std::lock_guard<std::mutex> lock(hough_pool_.mutex);
+        hough_pool_.task = task;
+        hough_pool_.running = hough_pool_.workers.size();
+        hough_pool_.generation++;
+      }
+      hough_pool_.start.notify_all();
+      task();
+      std::unique_lock<std::mutex> lock(hough_pool_.mutex);
+      hough_pool_.done.wait(lock, [&](){ return hough_pool_.running == 0; });
+    }
+
+    void EdgeDetection::detectLines(const cv::Mat & im_edges, const cv::Rect & roi, std::vector<cv::Vec4i> & lines){
+      lines.clear();
+      if((hough_tile_size_ <= 0)||((im_edges.rows <= hough_tile_size_)&&(im_edges.cols <= hough_tile_size_))){
+        HoughLinesP(im_edges, lines, 1, CV_PI/180, 5, 5, 5 );
+        // back to the coordinates of the full image
+        for( size_t i = 0; i < lines.size(); i++ ) {
+          lines[i][0] += roi.x;
+          lines[i][1] += roi.y;
+          lines[i][2] += roi.x;
+          lines[i][3] += roi.y;
+        }
+        return;
+      }
+
+      cv::Rect image_rect(0, 0, im_edges.cols, im_edges.rows);
+      std::vector<cv::Rect> tiles;
+      for(int r = 0; r < im_edges.rows; r += hough_tile_size_){
+        for(int c = 0; c < im_edges.cols; c += hough_tile_size_){
+          cv::Rect tile(c - hough_tile_overlap_, r - hough_tile_overlap_,
+                  hough_tile_size_ + 2*hough_tile_overlap_, hough_tile_size_ + 2*hough_tile_overlap_);
+          tiles.push_back(tile & image_rect);
+        }
+      }
+
+      // each worker picks the next unprocessed tile
+      std::vector<std::vector<cv::Vec4i>> tile_lines(tiles.size());
+      std::atomic<size_t> next_tile(0);
+      auto worker = [&](){
+        for(size_t t = next_tile++; t < tiles.size(); t = next_tile++){
+          HoughLinesP(im_edges(tiles[t]), tile_lines[t], 1, CV_PI/180, 5, 5, 5 );
+          // back to the coordinates of the full image
+          for( size_t i = 0; i < tile_lines[t].size(); i++ ) {
+            tile_lines[t][i][0] += tiles[t].x + roi.x;
+            tile_lines[t][i][1] += tiles[t].y + roi.y;
+            tile_lines[t][i][2] += tiles[t].x + roi.x;
+            tile_lines[t][i][3] += tiles[t].y + roi.y;
+          }
+        }
+      };
+      runOnHoughWorkers(worker);
+
+      for( size_t t = 0; t < tiles.size(); t++ ){
+        tiles[t].x += roi.x;
+        tiles[t].y += roi.y;
+      }
+      stitchTileLines(roi, tiles, tile_lines, lines);
+    }
+
+    void EdgeDetection::stitchTileLines(const cv::Rect & roi,
+            const std::vector<cv::Rect> & tiles,
+            const std::vector<std::vector<cv::Vec4i>> & tile_lines,
+            std::vector<cv::Vec4i> & lines){
+      struct Segment {
+        Eigen::Vector2d a;
+        Eigen::Vector2d b;
+        size_t tile;
+      };
+      const double band_width = 2.0*hough_tile_overlap_ + 1.0; // pixels, shared by two neighbouring tiles
+      const double max_offset = 2.0; // pixels, across the segment
+      const double max_gap = hough_tile_overlap_ + 2.0; // pixels, along the segment
+      const double min_cos_angle = cos(5.0*M_PI/180.0);
+
+      // a segment crossing the band shared with a neighbouring tile is also found (in part) by that tile, so all
+      // of them are stitched; the others cannot have a copy in another tile
+      auto crosses = [](double a, double b, double band_min, double band_max){
+        return (std::min(a, b) <= band_max)&&(std::max(a, b) >= band_min);
+      };
+      std::vector<Segment> segments;
+      for( size_t t = 0; t < tiles.size(); t++ ){
+        const cv::Rect & tile = tiles[t];
+        for( size_t i = 0; i < tile_lines[t].size(); i++ ){
+          const cv::Vec4i & l = tile_lines[t][i];
+          Segment segment = {Eigen::Vector2d(l[0], l[1]), Eigen::Vector2d(l[2], l[3]), t};
+          bool in_overlap = false;
+          if(tile.x > roi.x){
+            in_overlap |= crosses(l[0], l[2], tile.x, tile.x + band_width);
+          }
+          if(tile.y > roi.y){
+            in_overlap |= crosses(l[1], l[3], tile.y, tile.y + band_width);
+          }
+          if(tile.x + tile.width < roi.x + roi.width){
+            in_overlap |= crosses(l[0], l[2], tile.x + tile.width - band_width, tile.x + tile.width);
+          }
+          if(tile.y + tile.height < roi.y + roi.height){
+            in_overlap |= crosses(l[1], l[3], tile.y + tile.height - band_width, tile.y + tile.height);
+          }
+          if(in_overlap){
+            segments.push_back(segment);
+          }else{
+            lines.push_back(l);
+          }
+        }
+      }
+
+      // group the collinear and overlapping segments of different tiles (union-find)
+      std::vector<size_t> parent(segments.size());
+      std::iota(parent.begin(), parent.end(), 0);
+      std::function<size_t(size_t)> root = [&](size_t i){
+        return parent[i] == i ? i : parent[i] = root(parent[i]);
+      };
+      Eigen::Vector2d base_pos = base_pose_.segment(0,2);
+      double resolution = gridMap_->getResolution();
+      for( size_t i = 0; i < segments.size(); i++ ){
+        const Segment & s1 = segments[i];
+        double length1 = (s1.b - s1.a).norm();
+        if(length1 < 1e-6){
+          continue;
+        }
+        Eigen::Vector2d dir = (s1.b - s1.a)/length1;
+        Eigen::Vector2d normal(-dir[1], dir[0]);
+        EdgeContainer edge1;
+        edge1.point1_wf = convertImageToOdomFrame(resolution, gridMap_->getSize(), s1.a[0], s1.a[1]);
+        edge1.point2_wf = convertImageToOdomFrame(resolution, gridMap_->getSize(), s1.b[0], s1.b[1]);
+        setEdgeYaw(edge1, computeEdgeOrientation(edge1.point1_wf, edge1.point2_wf));
+
+        for( size_t j = i + 1; j < segments.size(); j++ ){
+          const Segment & s2 = segments[j];
+          if(s1.tile == s2.tile){
+            continue;
+          }
+          double length2 = (s2.b - s2.a).norm();
+          if((length2 < 1e-6)||(fabs(dir.dot(s2.b - s2.a))/length2 < min_cos_angle)){
+            continue;
+          }
+          if((fabs(normal.dot(s2.a - s1.a)) > max_offset)||(fabs(normal.dot(s2.b - s1.a)) > max_offset)){
+            continue;
+          }
+          double t_min = std::min(dir.dot(s2.a - s1.a), dir.dot(s2.b - s1.a));
+          double t_max = std::max(dir.dot(s2.a - s1.a), dir.dot(s2.b - s1.a));
+          if((t_min > length1 + max_gap)||(t_max < -max_gap)){
+            continue;
+          }
+          Eigen::Vector2d p1 = convertImageToOdomFrame(resolution, gridMap_->getSize(), s2.a[0], s2.a[1]);
+          Eigen::Vector2d p2 = convertImageToOdomFrame(resolution, gridMap_->getSize(), s2.b[0], s2.b[1]);
+          if(hasSimilarLineCoefficients(edge1, p1, p2, base_pos)){
+            parent[root(j)] = root(i);
+          }
+        }
+      }
+
+      // each group becomes the segment between its two extreme endpoints
+      std::vector<std::vector<size_t>> groups(segments.size());
+      for( size_t i = 0; i < segments.size(); i++ ){
+        groups[root(i)].push_back(i);
+      }
+      for( size_t g = 0; g < groups.size(); g++ ){
+        if(groups[g].empty()){
+          continue;
+        }
+        const Segment & reference = segments[groups[g].front()];
+        Eigen::Vector2d dir = (reference.b - reference.a).normalized();
+        Eigen::Vector2d p_min = reference.a;
+        Eigen::Vector2d p_max = reference.a;
+        double t_min = 0.0;
+        double t_max = 0.0;
+        for(const size_t & i : groups[g]){
+          for(const Eigen::Vector2d & p : {segments[i].a, segments[i].b}){
+            double t = dir.dot(p - reference.a);
+            if(t < t_min){
+              t_min = t;
+              p_min = p;
+            }
+            if(t > t_max){
+              t_max = t;
+              p_max = p;
+            }
+          }
+        }
+        lines.push_back(cv::Vec4i((int)p_min[0], (int)p_min[1], (int)p_max[0], (int)p_max[1]));
+      }
+    }
+
+    void EdgeDetection::setNumberOfSortedEdges(const int & number_of_edges){
+      number_of_sorted_edges_ = number_of_edges;
+    }
+
+    void EdgeDetection::updateRobotSpeed(const Eigen::Vector3d & base_pose){
+      double stamp = 1e-9*(double)gridMap_->getTimestamp();
+      current_stamp_ = stamp;
+      double dt = stamp - previous_stamp_;
+      if((previous_stamp_ > 0.0)&&(dt > 0.0)){
+        robot_speed_ = (base_pose.segment(0,2) - previous_base_pose_.segment(0,2)).norm()/dt;
+      }
+      previous_stamp_ = stamp;
+      previous_base_pose_ = base_pose;
+    }
+
+    cv::Rect EdgeDetection::computeRegionOfInterest(const int & rows, const int & cols){
+      double forward = std::min(roi_radius_ + roi_speed_gain_*robot_speed_, roi_max_radius_);
+      double half_x = forward;
+      double half_y = forward;
+      if(roi_mode_ == RoiMode::ELLIPSE){
+        // axis aligned bounding box of the ellipse oriented as the robot
+        double lateral = roi_radius_;
+        double yaw = base_pose_(2);
+        half_x = sqrt(pow(forward*cos(yaw),2) + pow(lateral*sin(yaw),2));
+        half_y = sqrt(pow(forward*sin(yaw),2) + pow(lateral*cos(yaw),2));
+      }
+
+      Eigen::Vector2d base_pos = base_pose_.segment(0,2);
+      Eigen::Vector2d c1 = convertOdomToImageFrame(gridMap_->getResolution(), gridMap_->getSize(), base_pos + Eigen::Vector2d(half_x, half_y));
+      Eigen::Vector2d c2 = convertOdomToImageFrame(gridMap_->getResolution(), gridMap_->getSize(), base_pos - Eigen::Vector2d(half_x, half_y));
+
+      int margin = 11/2 + 1; // half kernel of the median filter
+      int min_col = (int)floor(std::min(c1[0], c2[0])) - margin;
+      int max_col = (int)ceil(std::max(c1[0], c2[0])) + margin;
+      int min_row = (int)floor(std::min(c1[1], c2[1])) - margin;
+      int max_row = (int)ceil(std::max(c1[1], c2[1])) + margin;
+
+      cv::Rect roi(min_col, min_row, std::max(max_col - min_col, 0), std::max(max_row - min_row, 0));
+      return roi & cv::Rect(0, 0, cols, rows);
+    }
+
+    void EdgeDetection::maskRegionOfInterest(cv::Mat & im_edges, const cv::Rect & roi){
+      double forward = std::min(roi_radius_ + roi_speed_gain_*robot_speed_, roi_max_radius_);
+      double yaw = base_pose_(2);
+      Eigen::Matrix2d rotation; // odom frame to robot heading frame
+      rotation << cos(yaw), sin(yaw),
+                 -sin(yaw), cos(yaw);
+      Eigen::Vector2d base_pos = base_pose_.segment(0,2);
+
+      for(int r = 0; r < im_edges.rows; r++){
+        unsigned char * row = im_edges.ptr<unsigned char>(r);
+        for(int c = 0; c < im_edges.cols; c++){
+          if(row[c] == 0){
+            continue;
+          }
+          Eigen::Vector2d p_wf = convertImageToOdomFrame(gridMap_->getResolution(), gridMap_->getSize(), c + roi.x, r + roi.y);
+          if(!isInsideEllipse(rotation, base_pos, p_wf, forward, roi_radius_)){
+            row[c] = 0;
+          }
+        }
+      }
     }
 
     void EdgeDetection::setFakeEdges(const Eigen::Vector3d & base_pose){
 
       base_pose_ = base_pose;
       edges_.clear();
+      edge_index_.clear();
+      sorted_edges_end_ = 0;
+      changed_sorted_edges_.clear();
 
       Eigen::MatrixXd fake_points_wf(10,4);
       fake_points_wf << 0.74, 0.5, 0.74, -0.5,
@@ -106,99 +556,209 @@ namespace edge_detection {
         new_edge.length = 1.0;
         new_edge.height = fake_height[i];
         new_edge.z = fake_height[i];
-        new_edge.yaw = 1.57;
-        new_edge.line_coeffs = Eigen::Vector2d(sin(new_edge.yaw), cos(new_edge.yaw));
+        setEdgeYaw(new_edge, 1.57);
+        new_edge.id = next_edge_id_++;
+        new_edge.hits = 1;
+        new_edge.last_seen_frame = frame_count_;
+        new_edge.last_seen = current_stamp_;
+        updateEdgeDistance(new_edge);
 
         if (!isEdgeRedundant(new_edge.point1_wf, new_edge.point2_wf)) {
           edges_.push_back(new_edge);
+          edge_index_.insert(edges_.size() - 1, new_edge);
           orthogonal_edge_indices_.push_back(i);
         }
       }
     }
 
     void EdgeDetection::checkExistingEdges(const Eigen::Vector3d & base_pose){
+      evictEdges(base_pose);
       if(edges_.size()>0){
-        std::vector<edge_detection::EdgeContainer> edges_tmp = edges_;
-        edges_.clear();
-        for( size_t i = 0; i < edges_tmp.size(); i++ ){
-          double height_check = computeStepHeight(edges_tmp.at(i).point1_wf, edges_tmp.at(i).point2_wf, edges_tmp.at(i).z);
+        size_t kept = 0;
+        for( size_t i = 0; i < edges_.size(); i++ ){
+          double height_check = updateStepHeight(edges_.at(i));
           if((fabs(height_check) > min_height_)&&(fabs(height_check)< max_height_)){
-            double robot_yaw = base_pose[2];
-              edges_.push_back(edges_tmp.at(i));
+            if(kept != i){
+              edges_.at(kept) = std::move(edges_.at(i));
+            }
+            kept++;
+          }
+        }
+        edges_.resize(kept);
+      }
+      sortEdgesFromClosestToFurthest(base_pose);
+      edge_index_.build(edges_);
+    }
+
+    void EdgeDetection::evictEdges(const Eigen::Vector3d & base_pose){
+      Eigen::Vector2d base_pos = Eigen::Vector2d(base_pose[0], base_pose[1]);
+      size_t kept = 0;
+      for( size_t i = 0; i < edges_.size(); i++ ){
+        const EdgeContainer & edge = edges_.at(i);
+        bool too_old = (max_edge_age_ > 0.0)&&((current_stamp_ - edge.last_seen) > max_edge_age_);
+        bool too_far = (max_edge_distance_ > 0.0)&&(((edge.point1_wf + edge.point2_wf)/2.0 - base_pos).norm() > max_edge_distance_);
+        if(!too_old && !too_far){
+          if(kept != i){
+            edges_.at(kept) = std::move(edges_.at(i));
+          }
+          kept++;
+        }
+      }
+      edges_.resize(kept);
+
+      if((max_edges_ >= 0)&&((int)edges_.size() > max_edges_)){
+        // keep the most recently detected edges, in their current order
+        std::vector<int> V(edges_.size());
+        std::iota(V.begin(), V.end(), 0);
+        std::nth_element(V.begin(), V.begin() + max_edges_, V.end(), [&](int i, int j){
+          if(edges_.at(i).last_seen != edges_.at(j).last_seen){
+            return edges_.at(i).last_seen > edges_.at(j).last_seen;
+          }
+          return edges_.at(i).hits > edges_.at(j).hits;
+        });
+        std::vector<bool> keep(edges_.size(), false);
+        for( int i = 0; i < max_edges_; i++ ){
+          keep[V[i]] = true;
+        }
+        kept = 0;
+        for( size_t i = 0; i < edges_.size(); i++ ){
+          if(keep[i]){
+            if(kept != i){
+              edges_.at(kept) = std::move(edges_.at(i));
+            }
+            kept++;
           }
         }
+        edges_.resize(kept);
+      }
+    }
 
-        sortEdgesFromClosestToFurthest(base_pose);
+    bool EdgeDetection::isCloserEdge(const EdgeContainer & a, const EdgeContainer & b){
+      // confirmed edges first, so that the first sorted edges are the ones that get published
+      bool a_confirmed = a.hits >= min_hits_;
+      bool b_confirmed = b.hits >= min_hits_;
+      if(a_confirmed != b_confirmed){
+        return a_confirmed;
       }
+      return fabs(a.signed_distance) < fabs(b.signed_distance);
     }
 
     void EdgeDetection::sortEdgesFromClosestToFurthest(const Eigen::Vector3d & base_pose){
       if(edges_.size()>0){
 
-        std::vector<edge_detection::EdgeContainer> edges_tmp = edges_;
-        Eigen::VectorXd distances(edges_.size());
-        Eigen::Vector2d base_pos = Eigen::Vector2d(base_pose[0], base_pose[1]);
-        for( size_t i = 0; i < edges_.size(); i++ ){
-          distances[i] = computeSignedDistanceBtwEdgeAndBaseInWorldFrame(edges_.at(i).point1_wf, edges_.at(i).point2_wf, base_pos);
+        // the distances of the edges that moved are refreshed as they move, the others only change with the robot
+        Eigen::Vector2d base_pos = base_pose.segment(0,2);
+        if(base_pos != distances_base_pos_){
+          for( size_t i = 0; i < edges_.size(); i++ ){
+            updateEdgeDistance(edges_.at(i));
+          }
+          distances_base_pos_ = base_pos;
         }
 
-        std::vector<int> V(edges_.size());
-        int x=0;
-        std::iota(V.begin(),V.end(),x++); //Initializing
-        std::sort( V.begin(),V.end(), [&](int i,int j){return distances[i]<distances[j];} );
+        auto is_closer = [this](const EdgeContainer & a, const EdgeContainer & b){
+          return isCloserEdge(a, b);
+        };
 
-        edges_.clear();
-        for( size_t i = 0; i < edges_tmp.size(); i++ ){
-          edges_.push_back(edges_tmp.at(V.at(i)));
+        // only the first edges are published, the order of the others does not matter
+        if((number_of_sorted_edges_ > 0)&&(number_of_sorted_edges_ < (int)edges_.size())){
+          std::partial_sort(edges_.begin(), edges_.begin() + number_of_sorted_edges_, edges_.end(), is_closer);
+        }else{
+          std::sort(edges_.begin(), edges_.end(), is_closer);
         }
 
       }
+      sorted_edges_end_ = edges_.size();
+      changed_sorted_edges_.clear();
     }
 
     void EdgeDetection::findNewEdges(const std::vector<cv::Vec4i> & lines, const Eigen::Vector3d & base_pose_so2){
       orthogonal_edge_indices_.clear();
-      double robot_yaw_angle = base_pose_(2);
-      Eigen::Vector2d robot_pos = Eigen::Vector2d(base_pose_so2[0], base_pose_so2[1]);
 
       for( size_t i = 0; i < lines.size(); i++ ) {
         cv::Vec4i l = lines[i];
         EdgeContainer new_edge;
-        new_edge.point1_wf = convertImageToOdomFrame(gridMap_.getResolution(), gridMap_.getSize(), l[0], l[1]);
-        new_edge.point2_wf = convertImageToOdomFrame(gridMap_.getResolution(), gridMap_.getSize(), l[2], l[3]);
-        clockwiseSort(new_edge);
-        new_edge.length = computeLength(new_edge.point1_wf, new_edge.point2_wf);
-        if ((new_edge.length > min_length_)&&(new_edge.length < max_length_)) {
-          double edge_yaw_wf = computeEdgeOrientation(new_edge.point1_wf, new_edge.point2_wf);
-          new_edge.line_coeffs = Eigen::Vector2d(sin(edge_yaw_wf), cos(edge_yaw_wf));
-          Eigen::Vector2d target_pos = robot_pos + 1.0*Eigen::Vector2d(cos(robot_yaw_angle), sin(robot_yaw_angle));
-          Eigen::Vector2d edge_pos = (new_edge.point1_wf+new_edge.point2_wf)/2.0;
-          //if(isInsideEllipse(robot_yaw_angle, robot_pos, edge_pos, 1.0, 2.0)){
-            new_edge.height = computeStepHeight(new_edge.point1_wf, new_edge.point2_wf, new_edge.z);
-            if ((fabs(new_edge.height) > min_height_)&&(fabs(new_edge.height) < max_height_)){
-                if (!isEdgeRedundant(new_edge.point1_wf, new_edge.point2_wf)) {
-                  new_edge.yaw = edge_yaw_wf;
-                  new_edge.line_coeffs = Eigen::Vector2d(sin(new_edge.yaw), cos(new_edge.yaw));;
-                  edges_.push_back(new_edge);
-                  orthogonal_edge_indices_.push_back(i);
-                }
-            }
-          //}
+        new_edge.point1_wf = convertImageToOdomFrame(gridMap_->getResolution(), gridMap_->getSize(), l[0], l[1]);
+        new_edge.point2_wf = convertImageToOdomFrame(gridMap_->getResolution(), gridMap_->getSize(), l[2], l[3]);
+        addNewEdge(new_edge, i);
+      }
+
+    }
+
+    void EdgeDetection::addNewEdge(EdgeContainer & new_edge, const edge_idx & candidate_idx, const bool & measured){
+      clockwiseSort(new_edge);
+      new_edge.length = computeLength(new_edge.point1_wf, new_edge.point2_wf);
+      if ((new_edge.length > min_length_)&&(new_edge.length < max_length_)) {
+        double edge_yaw_wf = computeEdgeOrientation(new_edge.point1_wf, new_edge.point2_wf);
+        new_edge.line_coeffs = Eigen::Vector2d(sin(edge_yaw_wf), cos(edge_yaw_wf));
+        //if(isInsideEllipse(robot_yaw_angle, robot_pos, edge_pos, 1.0, 2.0)){
+          if (!measured) {
+            new_edge.height = updateStepHeight(new_edge);
+          }
+          if ((fabs(new_edge.height) > min_height_)&&(fabs(new_edge.height) < max_height_)){
+              if (!isEdgeRedundant(new_edge.point1_wf, new_edge.point2_wf, measured ? &new_edge : nullptr)) {
+                setEdgeYaw(new_edge, edge_yaw_wf);
+                new_edge.id = next_edge_id_++;
+                new_edge.hits = 1;
+                new_edge.last_seen_frame = frame_count_;
+                new_edge.last_seen = current_stamp_;
+                updateEdgeDistance(new_edge);
+                edges_.push_back(new_edge);
+                edge_index_.insert(edges_.size() - 1, new_edge);
+                orthogonal_edge_indices_.push_back(candidate_idx);
+              }
+          }
+        //}
 
-        }
       }
+    }
 
+    void EdgeDetection::updateEdgeDistance(EdgeContainer & edge){
+      Eigen::Vector2d base_pos = Eigen::Vector2d(base_pose_[0], base_pose_[1]);
+      edge.signed_distance = computeSignedDistanceBtwEdgeAndBaseInWorldFrame(edge.point1_wf, edge.point2_wf, base_pos);
     }
 
     edge_idx EdgeDetection::findNextEdge(){
-      double min_dist = 10000.0;
-      edge_idx closest_idx;
-      for( size_t i = 0; i < edges_.size(); i++ ){
-        Eigen::Vector2d base_pos = Eigen::Vector2d(base_pose_[0], base_pose_[1]);
-        double distance_from_base = computeDistanceBtwEdgeAndBaseInWorldFrame(edges_.at(i).point1_wf, edges_.at(i).point2_wf, base_pos);
-        if(distance_from_base<min_dist){
-          min_dist = distance_from_base;
+      size_t sorted_end = std::min(sorted_edges_end_, edges_.size());
+      std::vector<bool> changed(sorted_end, false);
+      for( const edge_idx & i : changed_sorted_edges_ ){
+        if((size_t)i < sorted_end){
+          changed[i] = true;
+        }
+      }
+
+      edge_idx closest_idx = -1;
+      auto consider = [&](const size_t & i){
+        if((closest_idx < 0)||isCloserEdge(edges_.at(i), edges_.at(closest_idx))){
           closest_idx = i;
         }
+      };
+
+      // in the sorted part the first unchanged edge is the closest of the unchanged ones; past a
+      // partial sort the order is lost, so the unchanged edges there are compared one by one
+      size_t ordered_end = (number_of_sorted_edges_ > 0) ? std::min(sorted_end, (size_t)number_of_sorted_edges_) : sorted_end;
+      size_t first_unchanged = 0;
+      while((first_unchanged < ordered_end)&&changed[first_unchanged]){
+        first_unchanged++;
+      }
+      if(first_unchanged < ordered_end){
+        consider(first_unchanged);
+      }else{
+        for( size_t i = ordered_end; i < sorted_end; i++ ){
+          consider(i);
+        }
+      }
+      // the edges updated or added since the sorting can be anywhere
+      for( const edge_idx & i : changed_sorted_edges_ ){
+        if((size_t)i < sorted_end){
+          consider(i);
+        }
+      }
+      for( size_t i = sorted_end; i < edges_.size(); i++ ){
+        consider(i);
+      }
+
+      if(closest_idx < 0){
+        closest_idx = 0;
       }
       closest_orthogonal_edge_index_ = closest_idx;
       return closest_idx;
@@ -211,17 +771,27 @@ namespace edge_detection {
       double p_x_base = (- p_y + gsy/2.0)*resolution;
       double p_y_base = (- p_x + gsx/2.0)*resolution;
       Eigen::Vector2d pos_bf = Eigen::Vector2d(p_x_base, p_y_base);
-      Eigen::Vector2d pos_odom_frame = pos_bf+gridMap_.getPosition();
+      Eigen::Vector2d pos_odom_frame = pos_bf+gridMap_->getPosition();
       return pos_odom_frame;
     }
 
+    Eigen::Vector2d EdgeDetection::convertOdomToImageFrame(const double & resolution, const Eigen::Array2i & grid_size, const Eigen::Vector2d & p_wf){
+
+      double gsx = grid_size[0];
+      double gsy = grid_size[1];
+      Eigen::Vector2d pos_bf = p_wf - gridMap_->getPosition();
+      double p_x = gsx/2.0 - pos_bf[1]/resolution;
+      double p_y = gsy/2.0 - pos_bf[0]/resolution;
+      return Eigen::Vector2d(p_x, p_y);
+    }
+
     double EdgeDetection::GetHeight(double & x, double & y) {
       grid_map::Position pos = {x,y};
-      if (!gridMap_.isInside(pos)){
+      if (!gridMap_->isInside(pos)){
         return 1e9;
       }
       else {
-        double height = static_cast<double>(gridMap_.atPosition("elevation", pos, grid_map::InterpolationMethods::INTER_NEAREST));
+        double height = static_cast<double>(gridMap_->atPosition("elevation", pos, grid_map::InterpolationMethods::INTER_NEAREST));
         if (std::isnan(height)) {
           return 1e9;
         }
@@ -255,6 +825,26 @@ namespace edge_detection {
       }
     }
 
+    bool EdgeDetection::isInsideEllipse(const Eigen::Matrix2d & rotation,
+            const Eigen::Vector2d & ellipse_center,
+            const Eigen::Vector2d & p,
+            const double & d1,
+            const double & d2){
+      Eigen::Vector2d point = rotation*(p - ellipse_center);
+      double y = point[0]*point[0]/(d1*d1) + point[1]*point[1]/(d2*d2);
+      return y<=1.0;
+    }
+
+    void EdgeDetection::setEdgeYaw(EdgeContainer & edge, const double & yaw){
+      edge.yaw = yaw;
+      edge.line_coeffs = Eigen::Vector2d(sin(yaw), cos(yaw));
+      // planar part of the rotation about z by (-yaw + M_PI/2) used by isInsideEllipse
+      double c = sin(yaw);
+      double s = cos(yaw);
+      edge.rotation << c, -s,
+                       s,  c;
+    }
+
     bool EdgeDetection::hasSimilarLineCoefficients(const EdgeContainer & existing_edge,
             const Eigen::Vector2d & p1,
             const Eigen::Vector2d & p2,
@@ -278,40 +868,122 @@ namespace edge_detection {
       return yaw_angle;
     }
 
+    bool EdgeDetection::getProvidedStepHeight(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf, double & height, double & z_coordinate){
+      if(!step_height_provider_){
+        return false;
+      }
+      double edge_yaw = computeEdgeOrientation(p1_wf, p2_wf);
+      Eigen::Vector2d edge_normal = computeNormalSign(p1_wf, p2_wf)*Eigen::Vector2d(sin(edge_yaw), cos(edge_yaw));
+      return step_height_provider_(p1_wf, p2_wf, edge_normal, height, z_coordinate);
+    }
+
     double EdgeDetection::computeStepHeight(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf, double & z_coordinate){
+      double height;
+      if(getProvidedStepHeight(p1_wf, p2_wf, height, z_coordinate)){
+        return height;
+      }
+      computeSampleIndices(p1_wf, p2_wf, sample_indices_);
+      return computeNormalSign(p1_wf, p2_wf)*sampleStepHeight(sample_indices_, z_coordinate);
+    }
 
-      double edge_yaw = computeEdgeOrientation(p1_wf, p2_wf);
-      Eigen::Vector2d edge_normal = Eigen::Vector2d(sin(edge_yaw), cos(edge_yaw));
+    double EdgeDetection::updateStepHeight(EdgeContainer & edge){
+      double provided_height;
+      if(getProvidedStepHeight(edge.point1_wf, edge.point2_wf, provided_height, edge.z)){
+        return provided_height;
+      }
 
-      Eigen::Vector2d robot_direction = Eigen::Vector2d(cos(base_pose_(2)), sin(base_pose_(2)));
-      double project_robot_direction_on_edge_normal = robot_direction.dot(edge_normal);
-      if(project_robot_direction_on_edge_normal<0){ //make sure that the edge normal is aligned with the robot to make code more robust against occlusions
-        edge_normal = -edge_normal;
+      StepHeightCache & cache = edge.height_cache;
+      bool same_edge = cache.valid && (cache.point1_wf == edge.point1_wf) && (cache.point2_wf == edge.point2_wf);
+
+      // an edge is measured several times per map, the height is only sampled once
+      if(!same_edge || (cache.frame != frame_count_)){
+        // the sampled cells keep their indices until the map moves or changes geometry
+        if(!same_edge || (cache.frame < map_change_frame_)){
+          computeSampleIndices(edge.point1_wf, edge.point2_wf, cache.sample_indices);
+          cache.point1_wf = edge.point1_wf;
+          cache.point2_wf = edge.point2_wf;
+          cache.valid = true;
+        }
+        cache.height = sampleStepHeight(cache.sample_indices, cache.z);
+        cache.frame = frame_count_;
       }
 
-      Eigen::VectorXd heights(10);
+      edge.z = cache.z;
+      return computeNormalSign(edge.point1_wf, edge.point2_wf)*cache.height;
+    }
+
+    void EdgeDetection::computeSampleIndices(const Eigen::Vector2d & p1_wf,
+            const Eigen::Vector2d & p2_wf,
+            std::vector<grid_map::Index> & indices){
+      double edge_yaw = computeEdgeOrientation(p1_wf, p2_wf);
+      Eigen::Vector2d edge_normal = Eigen::Vector2d(sin(edge_yaw), cos(edge_yaw));
+      double epsilon_plus = 0.15;
+      double epsilon_minus = 0.15;
 
+      indices.resize(20);
       for(int i = 0; i<10; i++){
         double idx = 0.1*(double)i + 0.05;
         Eigen::Vector2d p = p1_wf + (p2_wf - p1_wf)*idx;
-        heights(i) = computeHeight(edge_normal, p, z_coordinate);;
+        if(!gridMap_->getIndex(p + edge_normal*epsilon_plus, indices[2*i])){
+          indices[2*i] = grid_map::Index(-1, -1);
+        }
+        if(!gridMap_->getIndex(p - edge_normal*epsilon_minus, indices[2*i+1])){
+          indices[2*i+1] = grid_map::Index(-1, -1);
+        }
+      }
+    }
+
+    double EdgeDetection::sampleStepHeight(const std::vector<grid_map::Index> & indices, double & z_coordinate){
+      auto readHeight = [this](const grid_map::Index & index){
+        if((elevation_ == nullptr) || (index(0) < 0)){
+          return 1e9;
+        }
+        double height = static_cast<double>((*elevation_)(index(0), index(1)));
+        if (std::isnan(height)) {
+          return 1e9;
+        }
+        return height;
+      };
+
+      double heights_sum = 0.0;
+      for(size_t i = 0; i + 1 < indices.size(); i+=2){
+        double z1 = readHeight(indices[i]);
+        double z2 = readHeight(indices[i+1]);
+        z_coordinate = std::max(z1, z2);
+        heights_sum += z1 - z2;
       }
+      return heights_sum/(indices.size()/2);
+    }
 
-      double height = heights.sum()/heights.size();
-      return height;
+    double EdgeDetection::computeNormalSign(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf){
+      double edge_yaw = computeEdgeOrientation(p1_wf, p2_wf);
+      Eigen::Vector2d edge_normal = Eigen::Vector2d(sin(edge_yaw), cos(edge_yaw));
+      Eigen::Vector2d robot_direction = Eigen::Vector2d(cos(base_pose_(2)), sin(base_pose_(2)));
+      //make sure that the edge normal is aligned with the robot to make code more robust against occlusions
+      return (robot_direction.dot(edge_normal) < 0) ? -1.0 : 1.0;
     }
 
-    double EdgeDetection::computeHeight(const Eigen::Vector2d & edge_normal,
-            const Eigen::Vector2d & point2check,
-            double & z_coordinate){
-      double epsilon_plus = 0.15; //x_distribution_plus(rng);
-      double epsilon_minus = 0.15; //x_distribution_minus(rng);
-      Eigen::Vector2d middle_point_wf_plus = point2check + edge_normal*epsilon_plus;
-      Eigen::Vector2d middle_point_wf_minus = point2check - edge_normal*epsilon_minus;
-      double z1 = GetHeight(middle_point_wf_plus[0], middle_point_wf_plus[1]);
-      double z2 = GetHeight(middle_point_wf_minus[0], middle_point_wf_minus[1]);
-      z_coordinate = std::max(z1, z2);
-      return z1 - z2;
+    void EdgeDetection::updateMapState(){
+      frame_count_++;
+      if(!gridMap_->exists("elevation")){
+        elevation_ = nullptr;
+        map_change_frame_ = frame_count_;
+        return;
+      }
+
+      elevation_ = &(*gridMap_)["elevation"];
+      bool map_changed = (gridMap_->getResolution() != previous_resolution_) ||
+              (gridMap_->getSize() != previous_size_).any() ||
+              (gridMap_->getPosition() != previous_map_position_) ||
+              (gridMap_->getStartIndex() != previous_start_index_).any();
+      if(map_changed){
+        map_change_frame_ = frame_count_;
+      }
+
+      previous_resolution_ = gridMap_->getResolution();
+      previous_size_ = gridMap_->getSize();
+      previous_map_position_ = gridMap_->getPosition();
+      previous_start_index_ = gridMap_->getStartIndex();
     }
 
     double EdgeDetection::computeDistance(const Eigen::Vector2d & p1, const Eigen::Vector2d & p2){
@@ -334,30 +1006,52 @@ namespace edge_detection {
       return num/denum;
     }
 
-    bool EdgeDetection::isEdgeRedundant(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf){
+    bool EdgeDetection::isEdgeRedundant(const Eigen::Vector2d & p1_wf, const Eigen::Vector2d & p2_wf, const EdgeContainer * measured){
 
       bool merge_redundant_edges = true;
+      Eigen::Vector2d base_pos = base_pose_.segment(0,2);
 
-      for( size_t i = 0; i < edges_.size(); i++ )
-      {
-        bool d11 = isInsideEllipse(edges_.at(i).yaw, edges_.at(i).point1_wf, p1_wf, 0.2, min_length_);
-        bool d12 = isInsideEllipse(edges_.at(i).yaw, edges_.at(i).point2_wf, p1_wf, 0.2, min_length_);
-        bool d21 = isInsideEllipse(edges_.at(i).yaw, edges_.at(i).point1_wf, p2_wf, 0.2, min_length_);
-        bool d22 = isInsideEllipse(edges_.at(i).yaw, edges_.at(i).point2_wf, p2_wf, 0.2, min_length_);
-
-        Eigen::Vector2d base_pos = base_pose_.segment(0,2);
+      // only the edges with an endpoint close to the candidate can be redundant with it
+      edge_index_.query(p1_wf, p2_wf, redundancy_search_radius_, nearby_edges_);
 
-
-        if(hasSimilarLineCoefficients(edges_.at(i), p1_wf, p2_wf, base_pos)){
+      for( const edge_idx & i : nearby_edges_ )
+      {
+        EdgeContainer & edge = edges_.at(i);
+        if(hasSimilarLineCoefficients(edge, p1_wf, p2_wf, base_pos)){
+          // its hits and distance change, it may not be in sorted order anymore
+          if((size_t)i < sorted_edges_end_){
+            changed_sorted_edges_.push_back(i);
+          }
+          if(edge.last_seen_frame != frame_count_){
+            edge.hits++;
+            edge.last_seen_frame = frame_count_;
+          }
+          edge.last_seen = current_stamp_;
           if(merge_redundant_edges){
+            // running average over the detections, with a lower bound on the gain to keep following the map
+            double gain = std::max(1.0/edge.hits, edge_filter_min_gain_);
+            bool d11 = isInsideEllipse(edge.rotation, edge.point1_wf, p1_wf, 0.2, min_length_);
+            bool d22 = isInsideEllipse(edge.rotation, edge.point2_wf, p2_wf, 0.2, min_length_);
             if(d11&&d22){
-            edges_.at(i).point1_wf = (edges_.at(i).point1_wf + p1_wf)/2.0;
-            edges_.at(i).point2_wf = (edges_.at(i).point2_wf + p2_wf)/2.0;
+            edge.point1_wf += gain*(p1_wf - edge.point1_wf);
+            edge.point2_wf += gain*(p2_wf - edge.point2_wf);
+            }
+            edge.length = computeLength(edge.point1_wf, edge.point2_wf);
+            setEdgeYaw(edge, computeEdgeOrientation(edge.point1_wf, edge.point2_wf));
+            updateEdgeDistance(edge);
+            double measured_height;
+            if(measured){
+              measured_height = measured->height;
+              edge.z = measured->z;
+            }else{
+              measured_height = updateStepHeight(edge);
             }
-            edges_.at(i).length = computeLength(edges_.at(i).point1_wf, edges_.at(i).point2_wf);
-            edges_.at(i).yaw = computeEdgeOrientation(edges_.at(i).point1_wf, edges_.at(i).point2_wf);
-            edges_.at(i).line_coeffs = Eigen::Vector2d(sin(edges_.at(i).yaw), cos(edges_.at(i).yaw));
-            edges_.at(i).height = computeStepHeight(edges_.at(i).point1_wf, edges_.at(i).point2_wf, edges_.at(i).z);
+            if(measured_height*edge.height > 0.0){
+              edge.height += gain*(measured_height - edge.height);
+            }else{ // sign flipped with the robot heading
+              edge.height = measured_height;
+            }
+            edge_index_.update(i, edge);
           }
           return true;
         }
@@ -426,6 +1120,14 @@ namespace edge_detection {
       return edges_.at(closest_orthogonal_edge_index_).height;
     }
 
+    int EdgeDetection::getEdgeId(edge_idx idx){
+      return edges_.at(idx).id;
+    }
+
+    bool EdgeDetection::isEdgeConfirmed(edge_idx idx){
+      return edges_.at(idx).hits >= min_hits_;
+    }
+
     double EdgeDetection::getStepHeight(edge_idx idx){
       return edges_.at(idx).height;
     }
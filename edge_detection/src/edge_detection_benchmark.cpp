@@ -0,0 +1,234 @@
+/**
+ * @file edge_detection_benchmark.cpp
+ * @brief Offline benchmark of the edge detector on synthetic staircases with known edges
+ * @author Romeo Orsolino (rorsolino@robots.ox.ac.uk)
+ * @bug No known bugs.
+ * @date 17/10/2026
+ * @version 1.0
+ * @copyright 2020, Romeo Orsolino. BSD-3-Clause
+ */
+#include <edge_detection/edge_detection.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+
+namespace edge_detection {
+
+    /**
+    * @brief edge of the synthetic terrain, with the height of the step along the +x direction
+    */
+    struct GroundTruthEdge {
+        Eigen::Vector2d point1_wf;
+        Eigen::Vector2d point2_wf;
+        double height;
+    };
+
+    struct StaircaseConfig {
+        double resolution;
+        double noise;        // standard deviation of the elevation noise (m)
+        double nan_ratio;    // fraction of the cells without data
+    };
+
+    struct BenchmarkResult {
+        EdgeDetection::Timings mean_timings;
+        int detected;
+        int true_positives;
+        int matched_ground_truth;
+        double height_error;
+    };
+
+    /**
+    * @brief staircase going up along x, spanning the whole width of the map: flat ground, "steps" risers
+    * of "riser" meters every "tread" meters starting at x = "start", then a flat landing.
+    */
+    class SyntheticStaircase {
+    public:
+
+        SyntheticStaircase(const double & length_x, const double & length_y, const double & start,
+                const double & tread, const double & riser, const int & steps):
+        length_x_(length_x),
+        length_y_(length_y),
+        start_(start),
+        tread_(tread),
+        riser_(riser),
+        steps_(steps)
+        {
+          for(int k = 0; k < steps_; k++){
+            GroundTruthEdge edge;
+            double x = start_ + k*tread_;
+            edge.point1_wf = Eigen::Vector2d(x, length_y_/2.0);
+            edge.point2_wf = Eigen::Vector2d(x, -length_y_/2.0);
+            edge.height = riser_;
+            ground_truth_.push_back(edge);
+          }
+        }
+
+        /**
+        * @brief generate the elevation map of the staircase, with noise and missing cells
+        */
+        std::shared_ptr<grid_map::GridMap> generate(const StaircaseConfig & config, const int & frame, std::mt19937 & generator) const{
+          std::shared_ptr<grid_map::GridMap> map = std::make_shared<grid_map::GridMap>(std::vector<std::string>({"elevation"}));
+          map->setGeometry(grid_map::Length(length_x_, length_y_), config.resolution, grid_map::Position(0.0, 0.0));
+          map->setFrameId("odom");
+          map->setTimestamp((grid_map::Time)frame*500000000); // 2 Hz
+
+          std::normal_distribution<double> noise(0.0, config.noise);
+          std::uniform_real_distribution<double> uniform(0.0, 1.0);
+          grid_map::Matrix & elevation = (*map)["elevation"];
+          for(grid_map::GridMapIterator it(*map); !it.isPastEnd(); ++it){
+            const grid_map::Index index(*it);
+            grid_map::Position position;
+            map->getPosition(index, position);
+            if(uniform(generator) < config.nan_ratio){
+              elevation(index(0), index(1)) = std::numeric_limits<float>::quiet_NaN();
+              continue;
+            }
+            double z = getHeight(position[0]);
+            if(config.noise > 0.0){
+              z += noise(generator);
+            }
+            elevation(index(0), index(1)) = (float)z;
+          }
+          return map;
+        }
+
+        const std::vector<GroundTruthEdge> & getGroundTruth() const{
+          return ground_truth_;
+        }
+
+    private:
+
+        double getHeight(const double & x) const{
+          if(x < start_){
+            return 0.0;
+          }
+          int step = std::min(steps_, (int)std::floor((x - start_)/tread_) + 1);
+          return step*riser_;
+        }
+
+        double length_x_;
+        double length_y_;
+        double start_;
+        double tread_;
+        double riser_;
+        int steps_;
+        std::vector<GroundTruthEdge> ground_truth_;
+    };
+
+    /**
+    * @brief check whether a detected edge (middle point and yaw) lies on a ground truth edge
+    */
+    bool matchesGroundTruth(const Eigen::Vector2d & middle_point, const double & yaw, const GroundTruthEdge & edge,
+            const double & max_distance, const double & max_angle){
+      Eigen::Vector2d direction = edge.point2_wf - edge.point1_wf;
+      double length = direction.norm();
+      direction /= length;
+      Eigen::Vector2d detected_direction(cos(yaw), sin(yaw));
+      double sin_angle = direction[0]*detected_direction[1] - direction[1]*detected_direction[0];
+      if(std::fabs(sin_angle) > sin(max_angle)){
+        return false;
+      }
+      Eigen::Vector2d relative = middle_point - edge.point1_wf;
+      double along = relative.dot(direction);
+      double across = direction[0]*relative[1] - direction[1]*relative[0];
+      return (std::fabs(across) < max_distance)&&(along > -max_distance)&&(along < length + max_distance);
+    }
+
+    BenchmarkResult runBenchmark(const SyntheticStaircase & staircase, const StaircaseConfig & config, const int & frames){
+      std::string frame_name = "odom";
+      EdgeDetection detector(frame_name, 0.4, 0.02);
+      detector.setDebugImages(false);
+
+      // fixed seed: every run sees the same maps
+      std::mt19937 generator(42);
+      Eigen::Vector3d base_pose(-1.5, 0.0, 0.0);
+
+      BenchmarkResult result;
+      EdgeDetection::Timings & mean = result.mean_timings;
+      for(int f = 0; f < frames; f++){
+        std::shared_ptr<grid_map::GridMap> map = staircase.generate(config, f, generator);
+        detector.advance(base_pose, map);
+        const EdgeDetection::Timings & timings = detector.getTimings();
+        mean.image += timings.image/frames;
+        mean.blur += timings.blur/frames;
+        mean.canny += timings.canny/frames;
+        mean.hough += timings.hough/frames;
+        mean.check_existing_edges += timings.check_existing_edges/frames;
+        mean.find_new_edges += timings.find_new_edges/frames;
+        mean.total += timings.total/frames;
+      }
+
+      const std::vector<GroundTruthEdge> & ground_truth = staircase.getGroundTruth();
+      std::vector<bool> found(ground_truth.size(), false);
+      result.detected = 0;
+      result.true_positives = 0;
+      result.height_error = 0.0;
+      for(int i = 0; i < detector.numberOfDetectedEdges(); i++){
+        if(!detector.isEdgeConfirmed(i)){
+          continue;
+        }
+        result.detected++;
+        Eigen::Vector2d middle_point = detector.getPointAlongEdgeInWorldFrame(i);
+        double yaw = detector.getEdgeYawAngleInWorldFrame(i);
+        for(size_t k = 0; k < ground_truth.size(); k++){
+          if(matchesGroundTruth(middle_point, yaw, ground_truth[k], 0.1, 15.0*M_PI/180.0)){
+            result.true_positives++;
+            result.height_error += std::fabs(detector.getStepHeight(i) - ground_truth[k].height);
+            found[k] = true;
+            break;
+          }
+        }
+      }
+      result.matched_ground_truth = std::count(found.begin(), found.end(), true);
+      if(result.true_positives > 0){
+        result.height_error /= result.true_positives;
+      }
+      return result;
+    }
+
+} //end namespace
+
+int main(int argc, char *argv[])
+{
+  using namespace edge_detection;
+
+  int frames = (argc > 1) ? std::atoi(argv[1]) : 10;
+  if(frames < 1){
+    std::cout<<"usage: edge_detection_benchmark [frames per configuration]"<<std::endl;
+    return 1;
+  }
+
+  // 5 steps of 15 cm, 30 cm deep, on a 4 m x 1.2 m map
+  SyntheticStaircase staircase(4.0, 1.2, 0.0, 0.3, 0.15, 5);
+  const size_t ground_truth_edges = staircase.getGroundTruth().size();
+
+  std::vector<double> resolutions = {0.02, 0.04};
+  std::vector<double> noises = {0.0, 0.01};
+  std::vector<double> nan_ratios = {0.0, 0.05};
+
+  printf("%6s %6s %6s | %7s %7s %7s %7s %7s %7s %7s | %4s %9s %6s %8s\n",
+         "res", "noise", "nan", "image", "blur", "canny", "hough", "check", "find", "total",
+         "det", "precision", "recall", "h_err");
+  for(double resolution : resolutions){
+    for(double noise : noises){
+      for(double nan_ratio : nan_ratios){
+        StaircaseConfig config = {resolution, noise, nan_ratio};
+        BenchmarkResult result = runBenchmark(staircase, config, frames);
+        const EdgeDetection::Timings & t = result.mean_timings;
+        double precision = (result.detected > 0) ? (double)result.true_positives/result.detected : 0.0;
+        double recall = (double)result.matched_ground_truth/ground_truth_edges;
+        printf("%6.2f %6.3f %6.2f | %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f | %4d %9.2f %6.2f %8.3f\n",
+               resolution, noise, nan_ratio, t.image, t.blur, t.canny, t.hough, t.check_existing_edges, t.find_new_edges, t.total,
+               result.detected, precision, recall, result.height_error);
+      }
+    }
+  }
+  std::cout<<"timings in ms per frame, averaged over "<<frames<<" frames"<<std::endl;
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include <edge_detection/edge_grid_index.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace edge_detection {
+
+    EdgeGridIndex::EdgeGridIndex(const double & cell_size):
+    cell_size_(cell_size),
+    current_stamp_(0)
+    {
+    }
+
+    void EdgeGridIndex::setCellSize(const double & cell_size){
+      cell_size_ = cell_size;
+      clear();
+    }
+
+    void EdgeGridIndex::clear(){
+      cells_.clear();
+      edge_keys_.clear();
+      query_stamps_.clear();
+    }
+
+    void EdgeGridIndex::build(const std::vector<EdgeContainer> & edges){
+      clear();
+      for( size_t i = 0; i < edges.size(); i++ ){
+        insert(i, edges.at(i));
+      }
+    }
+
+    void EdgeGridIndex::insert(const edge_idx & idx, const EdgeContainer & edge){
+      if(idx >= (edge_idx)edge_keys_.size()){
+        edge_keys_.resize(idx + 1);
+        query_stamps_.resize(idx + 1, 0);
+      }
+      CellKey key1 = computeKey(edge.point1_wf);
+      CellKey key2 = computeKey(edge.point2_wf);
+      edge_keys_.at(idx) = {{key1, key2}};
+      cells_[key1].push_back(idx);
+      if(key2 != key1){
+        cells_[key2].push_back(idx);
+      }
+    }
+
+    void EdgeGridIndex::update(const edge_idx & idx, const EdgeContainer & edge){
+      if(idx < (edge_idx)edge_keys_.size()){
+        remove(idx);
+      }
+      insert(idx, edge);
+    }
+
+    void EdgeGridIndex::remove(const edge_idx & idx){
+      const std::array<CellKey, 2> & keys = edge_keys_.at(idx);
+      for(size_t k = 0; k < keys.size(); k++){
+        if((k == 1)&&(keys[1] == keys[0])){
+          continue;
+        }
+        auto cell = cells_.find(keys[k]);
+        if(cell == cells_.end()){
+          continue;
+        }
+        std::vector<edge_idx> & indices = cell->second;
+        indices.erase(std::remove(indices.begin(), indices.end(), idx), indices.end());
+        if(indices.empty()){
+          cells_.erase(cell);
+        }
+      }
+    }
+
+    void EdgeGridIndex::query(const Eigen::Vector2d & p1,
+            const Eigen::Vector2d & p2,
+            const double & radius,
+            std::vector<edge_idx> & candidates){
+      candidates.clear();
+      if(cells_.empty()){
+        return;
+      }
+
+      // stamps avoid returning twice an edge whose two endpoints fall in different visited cells
+      current_stamp_++;
+      if(current_stamp_ == 0){
+        std::fill(query_stamps_.begin(), query_stamps_.end(), 0);
+        current_stamp_ = 1;
+      }
+
+      int min_ix = (int)std::floor((std::min(p1[0], p2[0]) - radius)/cell_size_);
+      int max_ix = (int)std::floor((std::max(p1[0], p2[0]) + radius)/cell_size_);
+      int min_iy = (int)std::floor((std::min(p1[1], p2[1]) - radius)/cell_size_);
+      int max_iy = (int)std::floor((std::max(p1[1], p2[1]) + radius)/cell_size_);
+
+      for(int ix = min_ix; ix <= max_ix; ix++){
+        for(int iy = min_iy; iy <= max_iy; iy++){
+          auto cell = cells_.find(computeKey(ix, iy));
+          if(cell == cells_.end()){
+            continue;
+          }
+          for(const edge_idx & idx : cell->second){
+            if(query_stamps_.at(idx) != current_stamp_){
+              query_stamps_.at(idx) = current_stamp_;
+              candidates.push_back(idx);
+            }
+          }
+        }
+      }
+
+      // keep the same visiting order as a linear scan over the list of edges
+      std::sort(candidates.begin(), candidates.end());
+    }
+
+    EdgeGridIndex::CellKey EdgeGridIndex::computeKey(const int & ix, const int & iy) const{
+      return (static_cast<CellKey>(ix) << 32) ^ static_cast<CellKey>(static_cast<uint32_t>(iy));
+    }
+
+    EdgeGridIndex::CellKey EdgeGridIndex::computeKey(const Eigen::Vector2d & p) const{
+      return computeKey((int)std::floor(p[0]/cell_size_), (int)std::floor(p[1]/cell_size_));
+    }
+}
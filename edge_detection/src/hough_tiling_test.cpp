@@ -0,0 +1,60 @@
+/**
+ * @file hough_tiling_test.cpp
+ * @brief Regression test of the tiled Hough transform when its settings change between frames
+ * @author Romeo Orsolino (rorsolino@robots.ox.ac.uk)
+ * @bug No known bugs.
+ * @date 17/10/2026
+ * @version 1.0
+ * @copyright 2020, Romeo Orsolino. BSD-3-Clause
+ */
+#include <edge_detection/edge_detection.h>
+
+#include <iostream>
+
+namespace edge_detection {
+
+    /**
+    * @brief elevation map with a 1 x 1 m box in the middle, large enough to be split into several tiles
+    */
+    std::shared_ptr<grid_map::GridMap> generateBox(const int & frame){
+      std::shared_ptr<grid_map::GridMap> map = std::make_shared<grid_map::GridMap>(std::vector<std::string>({"elevation"}));
+      map->setGeometry(grid_map::Length(4.0, 4.0), 0.02, grid_map::Position(0.0, 0.0));
+      map->setFrameId("odom");
+      map->setTimestamp((grid_map::Time)frame*500000000);
+      grid_map::Matrix & elevation = (*map)["elevation"];
+      for(grid_map::GridMapIterator it(*map); !it.isPastEnd(); ++it){
+        const grid_map::Index index(*it);
+        grid_map::Position position;
+        map->getPosition(index, position);
+        bool on_box = (position[0] > -0.5)&&(position[0] < 0.5)&&(position[1] > -0.5)&&(position[1] < 0.5);
+        elevation(index(0), index(1)) = on_box ? 0.15f : 0.0f;
+      }
+      return map;
+    }
+
+} //end namespace
+
+int main()
+{
+  using namespace edge_detection;
+
+  std::string frame_name = "odom";
+  EdgeDetection detector(frame_name, 0.4, 0.02);
+  detector.setDebugImages(false);
+  Eigen::Vector3d base_pose(-1.5, 0.0, 0.0);
+
+  // the worker pool is restarted after tiled frames, with the same and with other settings
+  const int tilings[][3] = {{64, 8, 3}, {64, 8, 3}, {32, 4, 4}, {0, 0, 1}, {64, 8, 2}};
+  int failed = 0;
+  for(int f = 0; f < 5; f++){
+    detector.setHoughTiling(tilings[f][0], tilings[f][1], tilings[f][2]);
+    detector.advance(base_pose, generateBox(f));
+    if(detector.numberOfDetectedEdges() == 0){
+      std::cout<<"[hough_tiling_test] no edge detected at frame "<<f<<std::endl;
+      failed++;
+    }
+  }
+
+  std::cout<<"[hough_tiling_test] "<<failed<<" failed"<<std::endl;
+  return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,206 @@
+#include <edge_detection/plane_edge_extractor.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <plane_seg/Geometry.hpp>
+
+namespace edge_detection {
+
+    PlaneEdgeExtractor::PlaneEdgeExtractor():
+    min_length_(0.4),
+    max_length_(1.5),
+    min_height_(0.02),
+    max_gap_(0.1),
+    max_angle_(0.2),
+    cell_size_(0.5),
+    sampling_offset_(0.15)
+    {
+    }
+
+    void PlaneEdgeExtractor::setSegments(const std::vector<PlanarSegment> & segments, const double & min_normal_z){
+      segments_.clear();
+      centroids_.clear();
+      for( size_t i = 0; i < segments.size(); i++ ){
+        const PlanarSegment & segment = segments.at(i);
+        double norm = segment.plane.head<3>().norm();
+        if((segment.hull.size() < 3)||(norm == 0.0)||(std::fabs(segment.plane(2))/norm < min_normal_z)){
+          continue;
+        }
+        Eigen::Vector2d centroid = Eigen::Vector2d::Zero();
+        for( size_t j = 0; j < segment.hull.size(); j++ ){
+          centroid += segment.hull.at(j);
+        }
+        segments_.push_back(segment);
+        centroids_.push_back(centroid/(double)segment.hull.size());
+      }
+      buildIndex();
+    }
+
+    void PlaneEdgeExtractor::buildIndex(){
+      cells_.clear();
+      for( size_t i = 0; i < segments_.size(); i++ ){
+        const std::vector<Eigen::Vector2d> & hull = segments_.at(i).hull;
+        Eigen::Vector2d min_corner = hull.front();
+        Eigen::Vector2d max_corner = hull.front();
+        for( size_t j = 1; j < hull.size(); j++ ){
+          min_corner = min_corner.cwiseMin(hull.at(j));
+          max_corner = max_corner.cwiseMax(hull.at(j));
+        }
+        int min_ix = (int)std::floor(min_corner[0]/cell_size_);
+        int max_ix = (int)std::floor(max_corner[0]/cell_size_);
+        int min_iy = (int)std::floor(min_corner[1]/cell_size_);
+        int max_iy = (int)std::floor(max_corner[1]/cell_size_);
+        for(int ix = min_ix; ix <= max_ix; ix++){
+          for(int iy = min_iy; iy <= max_iy; iy++){
+            cells_[computeKey(ix, iy)].push_back(i);
+          }
+        }
+      }
+    }
+
+    PlaneEdgeExtractor::CellKey PlaneEdgeExtractor::computeKey(const int & ix, const int & iy) const{
+      return (static_cast<CellKey>(ix) << 32) ^ static_cast<CellKey>(static_cast<uint32_t>(iy));
+    }
+
+    void PlaneEdgeExtractor::setThresholds(const double & min_length, const double & max_length, const double & min_height,
+            const double & max_gap, const double & max_angle){
+      min_length_ = min_length;
+      max_length_ = max_length;
+      min_height_ = min_height;
+      max_gap_ = max_gap;
+      max_angle_ = max_angle;
+    }
+
+    void PlaneEdgeExtractor::extract(const Eigen::Vector3d & base_pose, std::vector<EdgeContainer> & edges){
+      edges.clear();
+      for( size_t i = 0; i < segments_.size(); i++ ){
+        for( size_t j = i + 1; j < segments_.size(); j++ ){
+          const std::vector<Eigen::Vector2d> & hull_i = segments_.at(i).hull;
+          const std::vector<Eigen::Vector2d> & hull_j = segments_.at(j).hull;
+          for( size_t s = 0; s < hull_i.size(); s++ ){
+            const Eigen::Vector2d & a = hull_i.at(s);
+            const Eigen::Vector2d & b = hull_i.at((s + 1)%hull_i.size());
+            double side_length = (b - a).norm();
+            if(side_length < min_length_){
+              continue;
+            }
+            Eigen::Vector2d direction = (b - a)/side_length;
+            Eigen::Vector2d normal(direction[1], -direction[0]);
+            // the two segments have to lie on opposite sides of the boundary
+            if((normal.dot(centroids_.at(i) - a) > 0.0) == (normal.dot(centroids_.at(j) - a) > 0.0)){
+              continue;
+            }
+
+            for( size_t t = 0; t < hull_j.size(); t++ ){
+              const Eigen::Vector2d & c = hull_j.at(t);
+              const Eigen::Vector2d & d = hull_j.at((t + 1)%hull_j.size());
+              double other_length = (d - c).norm();
+              if(other_length < min_length_){
+                continue;
+              }
+              Eigen::Vector2d other_direction = (d - c)/other_length;
+              double cross = direction[0]*other_direction[1] - direction[1]*other_direction[0];
+              if(std::fabs(cross) > sin(max_angle_)){
+                continue;
+              }
+              double gap_c = normal.dot(c - a);
+              double gap_d = normal.dot(d - a);
+              if((std::fabs(gap_c) > max_gap_)||(std::fabs(gap_d) > max_gap_)){
+                continue;
+              }
+
+              // overlap of the two sides along the boundary
+              double u_c = direction.dot(c - a);
+              double u_d = direction.dot(d - a);
+              double u_min = std::max(0.0, std::min(u_c, u_d));
+              double u_max = std::min(side_length, std::max(u_c, u_d));
+              if(u_max - u_min < min_length_){
+                continue;
+              }
+
+              // the edge runs halfway between the two sides
+              Eigen::Vector2d offset = normal*(gap_c + gap_d)/4.0;
+              addEdge(a + direction*u_min + offset, a + direction*u_max + offset, i, j, base_pose, edges);
+            }
+          }
+        }
+      }
+    }
+
+    void PlaneEdgeExtractor::addEdge(const Eigen::Vector2d & p1,
+            const Eigen::Vector2d & p2,
+            const size_t & first,
+            const size_t & second,
+            const Eigen::Vector3d & base_pose,
+            std::vector<EdgeContainer> & edges){
+      double total_length = (p2 - p1).norm();
+      int pieces = std::max(1, (int)std::ceil(total_length/max_length_));
+      Eigen::Vector2d robot_direction(cos(base_pose(2)), sin(base_pose(2)));
+
+      for(int k = 0; k < pieces; k++){
+        EdgeContainer edge;
+        Eigen::Vector2d q1 = p1 + (p2 - p1)*(double)k/pieces;
+        Eigen::Vector2d q2 = p1 + (p2 - p1)*(double)(k + 1)/pieces;
+        // yaw, distance and id are set by EdgeDetection, only the height has to follow its orientation convention
+        edge.point1_wf = (q1(0) > q2(0)) ? q1 : q2;
+        edge.point2_wf = (q1(0) > q2(0)) ? q2 : q1;
+        edge.length = total_length/pieces;
+        double yaw = atan2(edge.point1_wf[1] - edge.point2_wf[1], edge.point1_wf[0] - edge.point2_wf[0]);
+        Eigen::Vector2d edge_normal(sin(yaw), cos(yaw));
+        if(robot_direction.dot(edge_normal) < 0){
+          edge_normal = -edge_normal;
+        }
+
+        Eigen::Vector2d middle = (edge.point1_wf + edge.point2_wf)/2.0;
+        bool first_ahead = edge_normal.dot(centroids_.at(first) - middle) > 0.0;
+        double z_ahead = getPlaneHeight(first_ahead ? first : second, middle);
+        double z_behind = getPlaneHeight(first_ahead ? second : first, middle);
+        edge.height = z_ahead - z_behind;
+        if(std::fabs(edge.height) < min_height_){
+          continue;
+        }
+        edge.z = std::max(z_ahead, z_behind);
+        edges.push_back(edge);
+      }
+    }
+
+    bool PlaneEdgeExtractor::getStepHeight(const Eigen::Vector2d & p1_wf,
+            const Eigen::Vector2d & p2_wf,
+            const Eigen::Vector2d & edge_normal,
+            double & height,
+            double & z_coordinate) const{
+      Eigen::Vector2d middle = (p1_wf + p2_wf)/2.0;
+      double z_ahead, z_behind;
+      if(!getHeight(middle + edge_normal*sampling_offset_, z_ahead) || !getHeight(middle - edge_normal*sampling_offset_, z_behind)){
+        return false;
+      }
+      height = z_ahead - z_behind;
+      z_coordinate = std::max(z_ahead, z_behind);
+      return true;
+    }
+
+    bool PlaneEdgeExtractor::getHeight(const Eigen::Vector2d & p, double & z) const{
+      auto cell = cells_.find(computeKey((int)std::floor(p[0]/cell_size_), (int)std::floor(p[1]/cell_size_)));
+      if(cell == cells_.end()){
+        return false;
+      }
+      bool found = false;
+      for(const size_t & i : cell->second){
+        if(!planeseg::isInsidePolygon(segments_.at(i).hull, p)){
+          continue;
+        }
+        double segment_z = getPlaneHeight(i, p);
+        if(!found || (segment_z > z)){
+          z = segment_z;
+          found = true;
+        }
+      }
+      return found;
+    }
+
+    double PlaneEdgeExtractor::getPlaneHeight(const size_t & idx, const Eigen::Vector2d & p) const{
+      const Eigen::Vector4d & plane = segments_.at(idx).plane;
+      return -(plane(0)*p[0] + plane(1)*p[1] + plane(3))/plane(2);
+    }
+}
@@ -6,9 +6,13 @@
 #include <std_msgs/String.h>
 #include <std_msgs/Float64.h>
 #include <std_msgs/Header.h>
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
 
 #include <Eigen/Eigen>
 
+#include <grid_map_msgs/GridMap.h>
+#include <grid_map_ros/GridMapRosConverter.hpp>
+
 #include <edge_detection/edge_detection.h>
 #include <edge_detection/Edge.h>
 #include <edge_detection/EdgeArray.h>
@@ -20,9 +24,27 @@ namespace edge_detection {
     class EdgeDetectionRos: public EdgeDetection
     {
     public:
-        EdgeDetectionRos(ros::NodeHandle & node_handle, std::string & frame_name, double min_lenght, double height);
+        /**
+        * @brief set "subscribe_to_map" to false when the maps are decoded by the owner of the object and passed to update().
+        */
+        EdgeDetectionRos(ros::NodeHandle & node_handle, std::string & frame_name, double min_lenght, double height, bool subscribe_to_map = true);
         ~EdgeDetectionRos();
 
+        /**
+        * @brief detect the edges on an already decoded elevation map, then publish them.
+        */
+        void update(const std::shared_ptr<const grid_map::GridMap> & map);
+
+        /**
+        * @brief track the candidate edges found by other means on an already decoded elevation map, then publish them.
+        */
+        void update(const std::shared_ptr<const grid_map::GridMap> & map, const std::vector<EdgeContainer> & candidates);
+
+        /**
+        * @brief get the last robot pose (x, y, yaw) received on the pose topic.
+        */
+        const Eigen::Vector3d & getRobotState() const;
+
         edge_detection::EdgeArray createMessage();
 
         /**
@@ -34,9 +56,14 @@ namespace edge_detection {
 
         void UpdateEdges(const grid_map_msgs::GridMap& grid_map_in);
 
+        void publishEdges();
+
+        void UpdateRobotPose(const geometry_msgs::PoseWithCovarianceStampedConstPtr& pose_in);
+
         //ROS
         ros::NodeHandle node_handle_;
         ros::Subscriber elevation_map_sub_;
+        ros::Subscriber robot_pose_sub_;
         ros::Publisher edge_pub_;
         ros::Publisher edges_publisher_;
         Eigen::Vector3d robot_state_;
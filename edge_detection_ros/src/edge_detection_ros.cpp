@@ -2,15 +2,50 @@
 
 namespace edge_detection {
 
-    EdgeDetectionRos::EdgeDetectionRos(ros::NodeHandle &node_handle, std::string & frame_name, double min_length, double min_height) :
-            node_handle_(node_handle), EdgeDetection(node_handle, frame_name, min_length, min_height) {
+    EdgeDetectionRos::EdgeDetectionRos(ros::NodeHandle &node_handle, std::string & frame_name, double min_length, double min_height, bool subscribe_to_map) :
+            node_handle_(node_handle), EdgeDetection(frame_name, min_length, min_height) {
 
-      elevation_map_sub_ = node_handle_.subscribe("elevation_mapping/elevation_map", 1, &edge_detection::EdgeDetectionRos::UpdateEdges, this);
+      if(subscribe_to_map){
+        elevation_map_sub_ = node_handle_.subscribe("elevation_mapping/elevation_map", 1, &edge_detection::EdgeDetectionRos::UpdateEdges, this);
+      }
+      robot_pose_sub_ = node_handle_.subscribe("/state_estimator/pose_in_odom", 1, &edge_detection::EdgeDetectionRos::UpdateRobotPose, this);
       edge_pub_ = node_handle_.advertise<edge_detection::EdgeArray>("/edge_detection/edge_array", 1000);
       edges_publisher_ = node_handle_.advertise<visualization_msgs::MarkerArray>( "/edge_detection/detected_edges", 0 );
 
       number_of_published_edges_ = 6;
       std::cout<<"[EdgeDetection::detectEdges] size of edge array: "<<number_of_published_edges_<<std::endl;
+      setNumberOfSortedEdges(number_of_published_edges_);
+
+      robot_state_ = Eigen::Vector3d::Zero();
+
+      std::string roi_mode;
+      double roi_radius, roi_speed_gain, roi_max_radius;
+      node_handle_.param<std::string>("edge_detection/roi_mode", roi_mode, "none");
+      node_handle_.param("edge_detection/roi_radius", roi_radius, 1.5);
+      node_handle_.param("edge_detection/roi_speed_gain", roi_speed_gain, 1.0);
+      node_handle_.param("edge_detection/roi_max_radius", roi_max_radius, 3.0);
+      double max_edge_age, max_edge_distance, edge_filter_min_gain;
+      int max_edges, min_hits;
+      // eviction of the tracked edges, disabled unless set (e.g. 30 s, 5 m, 100 edges)
+      node_handle_.param("edge_detection/max_edge_age", max_edge_age, 0.0);
+      node_handle_.param("edge_detection/max_edge_distance", max_edge_distance, 0.0);
+      node_handle_.param("edge_detection/max_edges", max_edges, -1);
+      node_handle_.param("edge_detection/edge_filter_min_gain", edge_filter_min_gain, 0.2);
+      node_handle_.param("edge_detection/min_hits", min_hits, 1);
+      setEdgeLifetime(max_edge_age, max_edge_distance, max_edges);
+      setEdgeFilter(edge_filter_min_gain, min_hits);
+
+      int hough_tile_size, hough_tile_overlap, hough_threads;
+      node_handle_.param("edge_detection/hough_tile_size", hough_tile_size, 0);
+      node_handle_.param("edge_detection/hough_tile_overlap", hough_tile_overlap, 10);
+      node_handle_.param("edge_detection/hough_threads", hough_threads, 4);
+      setHoughTiling(hough_tile_size, hough_tile_overlap, hough_threads);
+
+      if(roi_mode == "window"){
+        setRegionOfInterest(RoiMode::WINDOW, roi_radius, roi_speed_gain, roi_max_radius);
+      }else if(roi_mode == "ellipse"){
+        setRegionOfInterest(RoiMode::ELLIPSE, roi_radius, roi_speed_gain, roi_max_radius);
+      }
     }
 
     EdgeDetectionRos::~EdgeDetectionRos() {
@@ -19,10 +54,13 @@ namespace edge_detection {
     edge_detection::EdgeArray EdgeDetectionRos::createMessage(){
       edge_detection::EdgeArray edges_array;
       for(int j = 0; j<numberOfDetectedEdges(); j++){
-        if(j<number_of_published_edges_){
+        if(!isEdgeConfirmed(j)){
+          continue;
+        }
+        if((int)edges_array.edges.size()<number_of_published_edges_){
           Eigen::Vector2d middle_point_wf = getPointAlongEdgeInWorldFrame(j);
           edge_detection::Edge new_edge;
-          new_edge.index = j;
+          new_edge.index = getEdgeId(j);
           geometry_msgs::Pose2D edge_pose;
           new_edge.step_height = getStepHeight(j);
           edge_pose.x = middle_point_wf[0];
@@ -37,8 +75,27 @@ namespace edge_detection {
     }
 
     void EdgeDetectionRos::UpdateEdges(const grid_map_msgs::GridMap&  grid_map_in) {
-      advance(robot_state_, grid_map_in);
+      std::shared_ptr<grid_map::GridMap> map = std::make_shared<grid_map::GridMap>();
+      grid_map::GridMapRosConverter::fromMessage(grid_map_in, *map);
+      advance(robot_state_, map);
+      publishEdges();
+    }
+
+    void EdgeDetectionRos::update(const std::shared_ptr<const grid_map::GridMap> & map) {
+      advance(robot_state_, map);
+      publishEdges();
+    }
 
+    void EdgeDetectionRos::update(const std::shared_ptr<const grid_map::GridMap> & map, const std::vector<EdgeContainer> & candidates) {
+      advance(robot_state_, map, candidates);
+      publishEdges();
+    }
+
+    const Eigen::Vector3d & EdgeDetectionRos::getRobotState() const {
+      return robot_state_;
+    }
+
+    void EdgeDetectionRos::publishEdges() {
       edge_detection::EdgeArray edges_array = createMessage();
 
       edge_pub_.publish(edges_array);
@@ -46,6 +103,13 @@ namespace edge_detection {
       plotEdges();
     }
 
+    void EdgeDetectionRos::UpdateRobotPose(const geometry_msgs::PoseWithCovarianceStampedConstPtr& pose_in) {
+      const geometry_msgs::Quaternion & q = pose_in->pose.pose.orientation;
+      robot_state_(0) = pose_in->pose.pose.position.x;
+      robot_state_(1) = pose_in->pose.pose.position.y;
+      robot_state_(2) = atan2(2.0*(q.w*q.z + q.x*q.y), 1.0 - 2.0*(q.y*q.y + q.z*q.z));
+    }
+
     void EdgeDetectionRos::plotEdges(){
 
       visualization_msgs::MarkerArray marker_array;
@@ -1,6 +1,8 @@
 #ifndef _planeseg_BlockFitter_hpp_
 #define _planeseg_BlockFitter_hpp_
 
+#include <string>
+
 #include "Types.hpp"
 
 namespace planeseg {
@@ -17,9 +19,25 @@ public:
     Eigen::Vector3f mSize;
     Eigen::Isometry3f mPose;
     std::vector<Eigen::Vector3f> mHull;
+    // labels of the input points of the block, only filled when the
+    // downsampling is disabled
+    std::vector<uint32_t> mInputLabels;
+  };
+  // wall-clock time of each stage of go(), in milliseconds
+  struct Timings {
+    float mVoxelize = 0;
+    float mGroundRemoval = 0;
+    float mNormals = 0;
+    float mSegmentation = 0;
+    float mRectangles = 0;
+    float mTotal = 0;
   };
   struct Result {
     bool mSuccess;
+    // the time budget ran out: either no blocks (mSuccess is false) or only
+    // the blocks fitted by then
+    bool mTimedOut = false;
+    Timings mTimings;
     std::vector<Block> mBlocks;
     Eigen::Vector4f mGroundPlane;
     std::vector<Eigen::Vector3f> mGroundPolygon;
@@ -33,6 +51,7 @@ public:
   void setSensorPose(const Eigen::Vector3f& iOrigin,
                      const Eigen::Vector3f& iLookDir);
   void setBlockDimensions(const Eigen::Vector3f& iDimensions);
+  // 0 to fit the input points as they are, e.g. the cells of a grid map
   void setDownsampleResolution(const float iRes);
   void setRemoveGround(const bool iVal);
   void setGroundBand(const float iMinZ, const float iMaxZ);
@@ -43,10 +62,23 @@ public:
   void setAreaThresholds(const float iMin, const float iMax);
   void setRectangleFitAlgorithm(const RectangleFitAlgorithm iAlgo);
   void setDebug(const bool iVal);
+  // normals and neighbor lists are stored in and reused from this
+  // directory (for static maps); disabled when empty
+  void setCacheDirectory(const std::string& iDir);
+  // go() stops within the normal estimation or after any other stage that
+  // exceeds it; no limit when 0
+  void setTimeBudget(const float iMilliseconds);
   void setCloud(const LabeledCloud::Ptr& iCloud);
+  // points given as coordinate arrays (e.g. a MappedCloud), which are
+  // voxelized in place without a copy; they must stay valid until go()
+  void setCloud(const float* iX, const float* iY, const float* iZ,
+                const int iNumPoints);
 
   Result go();
 
+protected:
+  void voxelize(LabeledCloud& oCloud) const;
+
 protected:
   Eigen::Vector3f mOrigin;
   Eigen::Vector3f mLookDir;
@@ -64,7 +96,13 @@ protected:
   float mAreaThreshMax;
   RectangleFitAlgorithm mRectangleFitAlgorithm;
   LabeledCloud::Ptr mCloud;
+  const float* mPointsX;
+  const float* mPointsY;
+  const float* mPointsZ;
+  int mNumPoints;
   bool mDebug;
+  std::string mCacheDirectory;
+  float mTimeBudget;
 };
 
 }
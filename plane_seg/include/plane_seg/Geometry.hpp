@@ -0,0 +1,25 @@
+#ifndef _planeseg_Geometry_hpp_
+#define _planeseg_Geometry_hpp_
+
+#include <cstddef>
+
+namespace planeseg {
+
+// crossing number test of a 2d point against a polygon given as a sequence
+// of 2d vertices (any Eigen vector type or expression, float or double)
+template<typename Polygon, typename Point>
+bool isInsidePolygon(const Polygon& iPoly, const Point& iPt) {
+  bool inside = false;
+  for (size_t j = 0, k = iPoly.size()-1; j < iPoly.size(); k = j++) {
+    if (((iPoly[j][1] > iPt[1]) != (iPoly[k][1] > iPt[1])) &&
+        (iPt[0] < (iPoly[k][0]-iPoly[j][0])*(iPt[1]-iPoly[j][1])/
+         (iPoly[k][1]-iPoly[j][1]) + iPoly[j][0])) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+
+}
+
+#endif
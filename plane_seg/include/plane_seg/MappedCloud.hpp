@@ -0,0 +1,63 @@
+#ifndef _planeseg_MappedCloud_hpp_
+#define _planeseg_MappedCloud_hpp_
+
+#include <cstdint>
+#include <string>
+
+#include "Types.hpp"
+
+namespace planeseg {
+
+// Binary cloud file: this header followed by the x, y and z coordinates as
+// three tightly packed float32 arrays. It is written once from a PCD/PLY file
+// and then mapped into memory, so the points are read without any parsing.
+struct CloudFileHeader {
+  char mMagic[8];
+  uint32_t mVersion;
+  uint32_t mNumPoints;
+  float mMinPoint[3];
+  float mMaxPoint[3];
+  float mOrigin[3];
+  float mLookDir[3];
+};
+
+// writes the finite points of iCloud along with the sensor pose
+bool writeCloudFile(const std::string& iFile, const LabeledCloud& iCloud,
+                    const Eigen::Vector3f& iOrigin,
+                    const Eigen::Vector3f& iLookDir);
+
+// read-only memory mapping of a binary cloud file; the coordinate arrays
+// are valid until the file is closed
+class MappedCloud {
+public:
+  MappedCloud();
+  ~MappedCloud();
+  MappedCloud(const MappedCloud&) = delete;
+  MappedCloud& operator=(const MappedCloud&) = delete;
+
+  bool open(const std::string& iFile);
+  void close();
+  bool isOpen() const { return mHeader != NULL; }
+
+  int size() const { return mHeader->mNumPoints; }
+  const float* x() const { return mX; }
+  const float* y() const { return mY; }
+  const float* z() const { return mZ; }
+
+  Eigen::Vector3f getMinPoint() const;
+  Eigen::Vector3f getMaxPoint() const;
+  Eigen::Vector3f getOrigin() const;
+  Eigen::Vector3f getLookDir() const;
+
+protected:
+  void* mData;
+  size_t mDataSize;
+  const CloudFileHeader* mHeader;
+  const float* mX;
+  const float* mY;
+  const float* mZ;
+};
+
+}
+
+#endif
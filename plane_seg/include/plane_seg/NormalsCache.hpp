@@ -0,0 +1,44 @@
+#ifndef _planeseg_NormalsCache_hpp_
+#define _planeseg_NormalsCache_hpp_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Types.hpp"
+
+namespace planeseg {
+
+// Persists the robust normals of a cloud and the neighbor lists of the
+// plane segmenter, so that a static map is processed only once. Entries
+// are files in a directory, named after a key that hashes the points and
+// every parameter the results depend on.
+class NormalsCache {
+public:
+  typedef std::vector<std::vector<int>> NeighborLists;
+
+public:
+  NormalsCache();
+
+  void setDirectory(const std::string& iDir);
+  bool isEnabled() const { return !mDirectory.empty(); }
+
+  // FNV-1a hash of the coordinates and the parameters
+  static uint64_t computeKey(const LabeledCloud& iCloud,
+                             const std::vector<float>& iParams);
+
+  bool load(const uint64_t iKey, NormalCloud& oNormals,
+            NeighborLists& oNeighbors) const;
+  bool save(const uint64_t iKey, const NormalCloud& iNormals,
+            const NeighborLists& iNeighbors) const;
+
+protected:
+  std::string getFileName(const uint64_t iKey) const;
+
+protected:
+  std::string mDirectory;
+};
+
+}
+
+#endif
@@ -14,6 +14,12 @@ public:
     float mCurvature;
   };
 
+  enum Scoring {
+    ScoringInlierCount,
+    ScoringMsac,
+    ScoringMlesac
+  };
+
 public:
   PlaneFitter();
   ~PlaneFitter();
@@ -23,14 +29,28 @@ public:
   void setMaxIterations(const int iIterations,
                         const float iSkipFactor=1.0f);
   void setRefineUsingInliers(const bool iVal);
+  // points passed in order of decreasing reliability are sampled best first
+  void setOrderedSampling(const bool iVal);
+  // refits every new best plane from its inliers (LO-RANSAC), each inner
+  // sample at most iNumRefits times
+  void setLocalOptimization(const bool iVal, const int iNumRefits=4);
+  void setScoring(const Scoring iScoring);
   void setNormalPrior(const Eigen::Vector3f& iNormal,
                       const float iMaxAngleDeviation);
+  // hypotheses take the prior normal and one sampled point, the final refit
+  // stays within the allowed deviation; needs a normal prior to be set.
+  // Local optimisation is always on in this mode, whatever
+  // setLocalOptimization says, as its refits are what brings the hypotheses
+  // from the prior onto the plane; the refit count is still taken from there
+  void setPriorNormalSampling(const bool iVal);
 
   Result go(const std::vector<Eigen::Vector3f>& iPoints) const;
 
 protected:
   template<typename T>
   Result solve(const std::vector<Eigen::Vector3f>& iPoints) const;
+  template<typename T, typename S>
+  Result solve(const std::vector<Eigen::Vector3f>& iPoints) const;
 
 protected:
   Eigen::Vector3f mCenterPoint;
@@ -38,10 +58,15 @@ protected:
   int mMaxIterations;
   float mSkippedIterationFactor;
   bool mRefineUsingInliers;
+  bool mOrderedSampling;
+  bool mLocalOptimization;
+  int mNumLocalRefits;
+  Scoring mScoring;
 
   Eigen::Vector3f mNormalPrior;
   float mMaxAngleDeviation;
   bool mCheckNormal;
+  bool mPriorNormalSampling;
 };
 
 }
@@ -27,6 +27,11 @@ public:
   void setSearchRadius(const float iRadius);
   void setMinPoints(const int iMin);
 
+  // neighbor lists of the points of setData(), sorted by distance, e.g. from
+  // a previous run on the same cloud; they are computed by go() otherwise
+  void setNeighbors(const std::vector<std::vector<int>>& iNeighbors);
+  const std::vector<std::vector<int>>& getNeighbors() const;
+
   Result go();
 
 protected:
@@ -36,6 +41,7 @@ protected:
   float mMaxAngle;
   float mSearchRadius;
   int mMinPoints;
+  std::vector<std::vector<int>> mNeighbors;
 };
 
 }
@@ -0,0 +1,63 @@
+#ifndef _planeseg_PlaneTracker_hpp_
+#define _planeseg_PlaneTracker_hpp_
+
+#include "BlockFitter.hpp"
+
+namespace planeseg {
+
+// Gives the blocks of successive results persistent ids, by matching each
+// block to a coplanar block of the previous result nearby (closest pairs
+// first), and reports which planes were added, changed or removed.
+class PlaneTracker {
+public:
+  enum Status {
+    Added,
+    Changed,
+    Unchanged,
+    Removed
+  };
+
+  struct Plane {
+    int mId;
+    Status mStatus;
+    Eigen::Vector4f mPlane;
+    std::vector<Eigen::Vector3f> mHull;
+  };
+
+public:
+  PlaneTracker();
+
+  void setMatchThresholds(const float iMaxAngle, const float iMaxOffset,
+                          const float iMaxDistance);
+  // largest move of the plane or of the hull outline (distance from the
+  // vertices of either hull to the other one) not reported as a change
+  void setChangeTolerance(const float iDist);
+
+  // the planes of iBlocks, in the same order, followed by the removed ones
+  std::vector<Plane> update(const std::vector<BlockFitter::Block>& iBlocks);
+  // the current planes, all reported as unchanged
+  std::vector<Plane> getPlanes() const;
+  void reset();
+
+protected:
+  struct Track {
+    int mId;
+    Eigen::Vector4f mPlane;
+    std::vector<Eigen::Vector3f> mHull;
+    Eigen::Vector3f mCentroid;
+  };
+
+  bool hasChanged(const Track& iOld, const Track& iNew) const;
+
+protected:
+  float mMaxAngle;
+  float mMaxOffset;
+  float mMaxDistance;
+  float mChangeTolerance;
+  std::vector<Track> mTracks;
+  int mNextId;
+};
+
+}
+
+#endif
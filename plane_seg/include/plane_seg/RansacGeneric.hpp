@@ -4,16 +4,113 @@
 #include <cmath>
 #include <vector>
 #include <algorithm>
+#include <numeric>
+#include <random>
 
 namespace drc {
 
+namespace detail {
+// per-point quality of the problem, higher is better, when it provides one
 template<typename Problem>
+auto getQualities(const Problem& iProblem, int) ->
+  decltype(std::vector<double>(iProblem.getQualities())) {
+  return iProblem.getQualities();
+}
+template<typename Problem>
+std::vector<double> getQualities(const Problem&, long) {
+  return std::vector<double>();
+}
+
+// rejection of degenerate samples before estimation, when the problem can tell
+template<typename Problem>
+auto isSampleValid(const Problem& iProblem, const std::vector<int>& iIndices,
+                   int) -> decltype(bool(iProblem.isSampleValid(iIndices))) {
+  return iProblem.isSampleValid(iIndices);
+}
+template<typename Problem>
+bool isSampleValid(const Problem&, const std::vector<int>&, long) {
+  return true;
+}
+
+// rejection of unacceptable solutions before scoring, when the problem can tell
+template<typename Problem>
+auto isModelValid(const Problem& iProblem,
+                  const typename Problem::Solution& iSolution, int) ->
+  decltype(bool(iProblem.isModelValid(iSolution))) {
+  return iProblem.isModelValid(iSolution);
+}
+template<typename Problem>
+bool isModelValid(const Problem&, const typename Problem::Solution&, long) {
+  return true;
+}
+}
+
+// Scoring policies: the score of a hypothesis from the squared errors of all
+// data points and the squared inlier threshold, the highest score wins.
+
+// number of inliers (plain RANSAC)
+struct InlierCountScoring {
+  static double score(const std::vector<double>& iErrors2,
+                      const double iThresh2) {
+    int count = 0;
+    for (const double e2 : iErrors2) count += (e2 <= iThresh2);
+    return count;
+  }
+};
+
+// truncated quadratic loss (MSAC): inliers also count by how well they fit
+struct MsacScoring {
+  static double score(const std::vector<double>& iErrors2,
+                      const double iThresh2) {
+    if (iThresh2 <= 0) return InlierCountScoring::score(iErrors2, iThresh2);
+    double score = 0;
+    for (const double e2 : iErrors2) {
+      if (e2 < iThresh2) score += 1 - e2/iThresh2;
+    }
+    return score;
+  }
+};
+
+// log likelihood of a gaussian inlier / uniform outlier mixture (MLESAC),
+// with the threshold at 1.96 sigma and the mixing ratio estimated by EM
+struct MlesacScoring {
+  static double score(const std::vector<double>& iErrors2,
+                      const double iThresh2) {
+    if (iThresh2 <= 0) return InlierCountScoring::score(iErrors2, iThresh2);
+    const int n = iErrors2.size();
+    const double sigma2 = iThresh2/(1.96*1.96);
+    const double norm = 1/std::sqrt(2*M_PI*sigma2);
+    double maxError2 = 0;
+    for (const double e2 : iErrors2) maxError2 = std::max(maxError2, e2);
+    const double outlierDensity =
+      1/std::max(2*std::sqrt(maxError2), 2*std::sqrt(iThresh2));
+
+    double gamma = 0.5;
+    for (int iter = 0; iter < 3; ++iter) {
+      double sum = 0;
+      for (const double e2 : iErrors2) {
+        const double pIn = gamma*norm*std::exp(-0.5*e2/sigma2);
+        sum += pIn/(pIn + (1-gamma)*outlierDensity);
+      }
+      gamma = sum/n;
+    }
+    double logLikelihood = 0;
+    for (const double e2 : iErrors2) {
+      logLikelihood += std::log(gamma*norm*std::exp(-0.5*e2/sigma2) +
+                                (1-gamma)*outlierDensity);
+    }
+    return logLikelihood;
+  }
+};
+
+template<typename Problem, typename Scoring = InlierCountScoring>
 class RansacGeneric {
 public:
   struct Result {
     bool mSuccess;
     typename Problem::Solution mSolution;
     std::vector<int> mInliers;
+    double mScore;
     int mNumIterations;
   };
 
@@ -24,6 +121,9 @@ public:
     setGoodSolutionProbability(1-1e-8);
     setRefineUsingInliers(false);
     setMaximumError(-1);
+    setOrderedSampling(false);
+    setLocalOptimization(false);
+    setSeed(std::mt19937::default_seed);
   }
 
   virtual ~RansacGeneric() {}
@@ -37,12 +137,29 @@ public:
   }
   void setRefineUsingInliers(const bool iVal) { mRefineUsingInliers = iVal; }
   void setMaximumError(const double iVal) { mMaximumError = iVal; }
+  // PROSAC: samples are drawn from a growing set of the best ranked points,
+  // ranked by Problem::getQualities() if it exists and by index otherwise
+  void setOrderedSampling(const bool iVal) { mOrderedSampling = iVal; }
+  // each call to solve draws its samples from its own engine seeded with
+  // this value, so that solvers can run concurrently and reproducibly
+  void setSeed(const unsigned int iSeed) { mSeed = iSeed; }
+  // LO-RANSAC: every new best solution is improved from its inliers by
+  // iInnerIterations samples of iSampleFactor times the minimal size, each
+  // refitted at most iNumRefits times by least squares
+  void setLocalOptimization(const bool iVal, const int iInnerIterations=10,
+                            const int iSampleFactor=7, const int iNumRefits=4) {
+    mLocalOptimization = iVal;
+    mInnerIterations = iInnerIterations;
+    mInnerSampleFactor = iSampleFactor;
+    mNumRefits = iNumRefits;
+  }
 
   Result solve(const Problem& iProblem) const {
     // set up initial (empty) result
     Result result;
     result.mSuccess = false;
     result.mNumIterations = 0;
+    result.mScore = 0;
 
     // ensure that there are enough data points to proceed
     const int sampleSize = iProblem.getSampleSize();
@@ -54,7 +171,7 @@ public:
     const double epsilon = 1e-10;
 
     // best results are currently invalid
-    int bestScore = 0;
+    double bestScore = 0;
     bool success = false;
 
     // start number of iterations as infinite, then reduce as we go
@@ -63,32 +180,89 @@ public:
     int skippedSampleCount = 0;
 
     // for random sample index generation
+    std::mt19937 engine(mSeed);
     std::vector<int> allIndices(n);
+    std::vector<int> sampleIndices(sampleSize);
+    // for the selection of the median error
+    std::vector<double> buffer;
 
-    // iterate until adaptive number of iterations are exceeded
-    while (iterationCount < numIterationsNeeded) {
-
-      // determine random sample indices
-      for (int i = 0; i < n; ++i) {
-        allIndices[i] = i;
+    // ranking and growth schedule of the sampled set for ordered sampling
+    std::vector<int> ranking, swaps(sampleSize);
+    int prosacSize = sampleSize;
+    double prosacT = mMaximumIterations;
+    double prosacTPrime = 1;
+    int prosacSampleCount = 0;
+    if (mOrderedSampling) {
+      ranking.resize(n);
+      std::iota(ranking.begin(), ranking.end(), 0);
+      const std::vector<double> qualities = detail::getQualities(iProblem, 0);
+      if ((int)qualities.size() == n) {
+        std::stable_sort(ranking.begin(), ranking.end(),
+                         [&qualities](const int iA, const int iB) {
+                           return qualities[iA] > qualities[iB]; });
       }
+      // expected number of samples drawn from the top sampleSize points
       for (int i = 0; i < sampleSize; ++i) {
-        int randIndex = std::rand() % n;
-        std::swap(allIndices[i], allIndices[randIndex]);
+        prosacT *= double(sampleSize-i) / (n-i);
       }
-      std::vector<int> sampleIndices(allIndices.begin(),
-                                     allIndices.begin() + sampleSize);
+    }
 
-      // compute solution on minimal set
-      typename Problem::Solution solution = iProblem.estimate(sampleIndices);
+    // iterate until adaptive number of iterations are exceeded
+    while (iterationCount < numIterationsNeeded) {
 
-      // compute errors over all data points
-      std::vector<double> errors2 = iProblem.computeSquaredErrors(solution);
+      if (mOrderedSampling) {
+        // grow the sampled set once it has had its share of samples
+        const int t = ++prosacSampleCount;
+        if ((t > prosacTPrime) && (prosacSize < n)) {
+          double nextT = prosacT*(prosacSize+1) / (prosacSize+1-sampleSize);
+          prosacTPrime += std::ceil(nextT - prosacT);
+          prosacT = nextT;
+          ++prosacSize;
+        }
+        // the newest point of the set is in the sample, unless the schedule
+        // has fallen behind and the set is sampled uniformly
+        int numDrawn = sampleSize;
+        int drawLimit = prosacSize;
+        if (t <= prosacTPrime) {
+          sampleIndices[sampleSize-1] = ranking[prosacSize-1];
+          numDrawn = sampleSize-1;
+          drawLimit = prosacSize-1;
+        }
+        for (int i = 0; i < numDrawn; ++i) {
+          swaps[i] = i + drawIndex(drawLimit-i, engine);
+          std::swap(ranking[i], ranking[swaps[i]]);
+          sampleIndices[i] = ranking[i];
+        }
+        // undo the swaps so that the ranking is preserved
+        for (int i = numDrawn-1; i >= 0; --i) {
+          std::swap(ranking[i], ranking[swaps[i]]);
+        }
+      }
+      else {
+        // determine random sample indices
+        for (int i = 0; i < n; ++i) {
+          allIndices[i] = i;
+        }
+        for (int i = 0; i < sampleSize; ++i) {
+          int randIndex = drawIndex(n, engine);
+          std::swap(allIndices[i], allIndices[randIndex]);
+        }
+        std::copy(allIndices.begin(), allIndices.begin() + sampleSize,
+                  sampleIndices.begin());
+      }
 
-      // check whether this is a valid sample
-      // TODO: this should be done via a method in Problem class, but would
-      // require changing all existing usages to include that method
-      if (errors2.size() == 0) {
+      // compute solution on minimal set, unless it is degenerate; invalid
+      // solutions are rejected by findInliers before any error is computed
+      // (or by an empty error vector, for problems without validity checks)
+      typename Problem::Solution solution;
+      std::vector<int> inliers;
+      double score;
+      bool valid = detail::isSampleValid(iProblem, sampleIndices, 0);
+      if (valid) {
+        solution = iProblem.estimate(sampleIndices);
+        valid = findInliers(iProblem, solution, inliers, score, buffer);
+      }
+      if (!valid) {
         ++skippedSampleCount;
         if (skippedSampleCount >=
             mMaximumIterations*mSkippedIterationFactor) break;
@@ -96,33 +270,17 @@ public:
       }
       skippedSampleCount = 0;
 
-      // compute error threshold to be applied to each term
-      double thresh = mMaximumError;
-      if (thresh < 0) {
-        std::sort(errors2.begin(), errors2.end());
-        double median = (n % 2 == 0) ?
-          (0.5*(errors2[n/2]+errors2[n/2+1])) : errors2[n/2];
-        thresh = 1.4826*std::sqrt(median)*4.6851;
-      }
-      thresh *= thresh;
-
-      // determine inliers
-      std::vector<int> inliers;
-      inliers.reserve(n);
-      for (int i = 0; i < n; ++i) {
-        if (errors2[i] <= thresh) {
-          inliers.push_back(i);
-        }
-      }
-
       // if this is the best score, update solution and convergence criteria
-      int score = inliers.size();
-      if (score > bestScore) {
-        bestScore = score;
+      if ((score > bestScore) || (!success && !inliers.empty())) {
         result.mInliers = inliers;
         result.mSolution = solution;
+        result.mScore = score;
         success = true;
-        double inlierProbability = double(inliers.size()) / n;
+        if (mLocalOptimization) {
+          localOptimize(iProblem, result, buffer, engine);
+        }
+        bestScore = result.mScore;
+        double inlierProbability = double(result.mInliers.size()) / n;
         double anyOutlierProbability = 1 - pow(inlierProbability,sampleSize);
         anyOutlierProbability = std::min(anyOutlierProbability, 1-epsilon);
         anyOutlierProbability = std::max(anyOutlierProbability, epsilon);
@@ -150,12 +308,102 @@ public:
     return result;
   }
 
+protected:
+  // errors of the solution over all data points, thresholded and scored
+  bool findInliers(const Problem& iProblem,
+                   const typename Problem::Solution& iSolution,
+                   std::vector<int>& oInliers, double& oScore,
+                   std::vector<double>& ioBuffer) const {
+    if (!detail::isModelValid(iProblem, iSolution, 0)) return false;
+    const std::vector<double> errors2 = iProblem.computeSquaredErrors(iSolution);
+    const int n = errors2.size();
+    if (n == 0) return false;
+
+    // compute error threshold to be applied to each term, from the median
+    // error found by partial selection
+    double thresh = mMaximumError;
+    if (thresh < 0) {
+      ioBuffer.assign(errors2.begin(), errors2.end());
+      auto mid = ioBuffer.begin() + n/2;
+      std::nth_element(ioBuffer.begin(), mid, ioBuffer.end());
+      double median = *mid;
+      if (n % 2 == 0) {
+        median = 0.5*(median + *std::max_element(ioBuffer.begin(), mid));
+      }
+      thresh = 1.4826*std::sqrt(median)*4.6851;
+    }
+    thresh *= thresh;
+
+    oInliers.clear();
+    oInliers.reserve(n);
+    for (int i = 0; i < n; ++i) {
+      if (errors2[i] <= thresh) {
+        oInliers.push_back(i);
+      }
+    }
+    oScore = Scoring::score(errors2, thresh);
+    return true;
+  }
+
+  // LO-RANSAC: non-minimal samples of the inliers of a new best solution,
+  // each followed by least squares refits on its own inliers
+  void localOptimize(const Problem& iProblem, Result& ioResult,
+                     std::vector<double>& ioBuffer,
+                     std::mt19937& ioEngine) const {
+    const int sampleSize = iProblem.getSampleSize();
+    const std::vector<int> bestInliers = ioResult.mInliers;
+    const int innerSampleSize =
+      std::min<int>(bestInliers.size()/2, mInnerSampleFactor*sampleSize);
+    const int numInner = (innerSampleSize > sampleSize) ? mInnerIterations : 1;
+
+    std::vector<int> pool(bestInliers), sample, inliers;
+    double score;
+    for (int k = 0; k < numInner; ++k) {
+      if (innerSampleSize > sampleSize) {
+        for (int i = 0; i < innerSampleSize; ++i) {
+          int randIndex = i + drawIndex(pool.size()-i, ioEngine);
+          std::swap(pool[i], pool[randIndex]);
+        }
+        sample.assign(pool.begin(), pool.begin() + innerSampleSize);
+      }
+      else {
+        sample = bestInliers;
+      }
+
+      // the refits are least squares fits, which need at least 3 points
+      // even when a hypothesis needs fewer
+      for (int r = 0; r <= mNumRefits; ++r) {
+        if ((int)sample.size() <= std::max(sampleSize, 2)) break;
+        typename Problem::Solution solution = iProblem.estimate(sample);
+        if (!findInliers(iProblem, solution, inliers, score, ioBuffer)) break;
+        if (score > ioResult.mScore) {
+          ioResult.mInliers = inliers;
+          ioResult.mSolution = solution;
+          ioResult.mScore = score;
+        }
+        else if (r > 0) break;
+        sample.swap(inliers);
+      }
+    }
+  }
+
+  // uniform index in [0,iCount)
+  static int drawIndex(const int iCount, std::mt19937& ioEngine) {
+    return std::uniform_int_distribution<int>(0, iCount-1)(ioEngine);
+  }
+
 protected:
   bool mRefineUsingInliers;
+  bool mLocalOptimization;
+  int mInnerIterations;
+  int mInnerSampleFactor;
+  int mNumRefits;
+  bool mOrderedSampling;
   int mMaximumIterations;
   double mSkippedIterationFactor;
   double mGoodSolutionProbability;
   double mMaximumError;
+  unsigned int mSeed;
 };
 
 }
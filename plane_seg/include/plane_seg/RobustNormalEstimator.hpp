@@ -14,6 +14,10 @@ public:
   void setMaxCenterError(const float iDist);
   void setMaxIterations(const int iIters);
   void computeCurvature(const bool iVal);
+  // samples the neighbors closest to each point first
+  void setOrderedSampling(const bool iVal);
+  // go() gives up and returns false past this time; no limit when 0
+  void setTimeBudget(const float iMilliseconds);
 
   bool go(const LabeledCloud::Ptr& iCloud, NormalCloud& oNormals);
 
@@ -23,6 +27,8 @@ protected:
   float mMaxCenterError;
   int mMaxIterations;
   bool mComputeCurvature;
+  bool mOrderedSampling;
+  float mTimeBudget;
 };
 
 }
@@ -0,0 +1,58 @@
+#ifndef _planeseg_ScanAccumulator_hpp_
+#define _planeseg_ScanAccumulator_hpp_
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "Types.hpp"
+
+namespace planeseg {
+
+// Fuses the last scans (at most N of them, and no older than T seconds) into
+// a voxel map. Each scan keeps the list of voxels it contributed to, so
+// evicting it only touches those voxels and the window is never voxelized
+// again from the raw points.
+class ScanAccumulator {
+public:
+  ScanAccumulator();
+
+  void setResolution(const float iRes);
+  void setMaxScans(const int iNum);
+  // 0 to keep the scans regardless of their age
+  void setMaxAge(const double iSeconds);
+
+  // iCloud is in the fixed frame of the window
+  void addScan(const LabeledCloud& iCloud, const double iTime);
+  // one point per occupied voxel, at the centroid of its points
+  void getCloud(LabeledCloud& oCloud) const;
+  void clear();
+
+  int getNumScans() const { return mScans.size(); }
+  int getNumVoxels() const { return mVoxels.size(); }
+
+protected:
+  struct Voxel {
+    Eigen::Vector3f mSum;
+    int mCount;
+  };
+  struct Scan {
+    double mTime;
+    std::vector<std::pair<uint64_t,Voxel>> mContributions;
+  };
+
+  uint64_t getKey(const Eigen::Vector3f& iPoint) const;
+  void evictOldest();
+
+protected:
+  float mResolution;
+  int mMaxScans;
+  double mMaxAge;
+  std::unordered_map<uint64_t,Voxel> mVoxels;
+  std::deque<Scan> mScans;
+};
+
+}
+
+#endif
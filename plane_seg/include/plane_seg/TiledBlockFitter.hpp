@@ -0,0 +1,68 @@
+#ifndef _planeseg_TiledBlockFitter_hpp_
+#define _planeseg_TiledBlockFitter_hpp_
+
+#include <string>
+
+#include "BlockFitter.hpp"
+#include "MappedCloud.hpp"
+
+namespace planeseg {
+
+// Runs BlockFitter on overlapping square tiles of a cloud too large to be
+// processed at once. The points are binned into per-tile files on disk,
+// buffering at most the memory budget (but at least 12 KB per tile), then
+// the tiles are fitted in parallel and the coplanar touching blocks of
+// neighbouring tiles (e.g. a plane cut by a tile border, or seen twice in an
+// overlap) are merged into one.
+// Peak memory is the budget during binning, then per thread one tile: its
+// points (12 bytes each) and the working set of BlockFitter on them (mostly
+// the 16 byte voxel keys of voxelize, freed before the fit itself).
+class TiledBlockFitter {
+public:
+  TiledBlockFitter();
+
+  // settings (sensor pose, thresholds) used for every tile
+  void setFitter(const BlockFitter& iFitter);
+  void setTileSize(const float iSize);
+  void setTileOverlap(const float iOverlap);
+  void setMemoryBudget(const size_t iBytes);
+  void setNumThreads(const int iNum);
+  // the tile files are written to a new temporary directory in there
+  void setSpillDirectory(const std::string& iDir);
+  void setMergeThresholds(const float iMaxAngle, const float iMaxOffset,
+                          const float iMaxGap);
+  void setDebug(const bool iVal);
+
+  BlockFitter::Result go(const MappedCloud& iCloud);
+
+protected:
+  bool spillTiles(const MappedCloud& iCloud, const std::string& iDir,
+                  std::vector<std::string>& oFiles) const;
+  bool fitTile(BlockFitter& ioFitter, const std::string& iFile,
+               std::vector<BlockFitter::Block>& oBlocks) const;
+  // iTiles holds the tile index of each block
+  std::vector<BlockFitter::Block>
+  mergeBlocks(const std::vector<BlockFitter::Block>& iBlocks,
+              const std::vector<int>& iTiles) const;
+
+protected:
+  BlockFitter mFitter;
+  float mTileSize;
+  float mTileOverlap;
+  size_t mMemoryBudget;
+  int mNumThreads;
+  std::string mSpillDirectory;
+  float mMaxMergeAngle;
+  float mMaxMergeOffset;
+  float mMaxMergeGap;
+  bool mDebug;
+
+  // tile grid of the current cloud
+  Eigen::Vector2f mGridOrigin;
+  int mNumTilesX;
+  int mNumTilesY;
+};
+
+}
+
+#endif
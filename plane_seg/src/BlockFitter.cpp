@@ -1,6 +1,8 @@
 #include "plane_seg/BlockFitter.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <fstream>
 
 #include <pcl/filters/voxel_grid.h>
@@ -12,6 +14,7 @@
 #include "plane_seg/RobustNormalEstimator.hpp"
 #include "plane_seg/PlaneSegmenter.hpp"
 #include "plane_seg/RectangleFitter.hpp"
+#include "plane_seg/NormalsCache.hpp"
 
 using namespace planeseg;
 
@@ -29,6 +32,9 @@ BlockFitter() {
   setAreaThresholds(0.5, 1.5);
   setRectangleFitAlgorithm(RectangleFitAlgorithm::MinimumArea);
   setDebug(true);
+  mPointsX = mPointsY = mPointsZ = NULL;
+  mNumPoints = 0;
+  setTimeBudget(0);
 }
 
 void BlockFitter::
@@ -95,6 +101,18 @@ setRectangleFitAlgorithm(const RectangleFitAlgorithm iAlgo) {
 void BlockFitter::
 setCloud(const LabeledCloud::Ptr& iCloud) {
   mCloud = iCloud;
+  mPointsX = mPointsY = mPointsZ = NULL;
+  mNumPoints = 0;
+}
+
+void BlockFitter::
+setCloud(const float* iX, const float* iY, const float* iZ,
+         const int iNumPoints) {
+  mCloud.reset();
+  mPointsX = iX;
+  mPointsY = iY;
+  mPointsZ = iZ;
+  mNumPoints = iNumPoints;
 }
 
 void BlockFitter::
@@ -102,29 +120,152 @@ setDebug(const bool iVal) {
   mDebug = iVal;
 }
 
+void BlockFitter::
+setTimeBudget(const float iMilliseconds) {
+  mTimeBudget = iMilliseconds;
+}
+
+void BlockFitter::
+setCacheDirectory(const std::string& iDir) {
+  mCacheDirectory = iDir;
+}
+
+namespace {
+float elapsedMilliseconds(std::chrono::high_resolution_clock::time_point& ioStart) {
+  auto now = std::chrono::high_resolution_clock::now();
+  float dt = std::chrono::duration<float,std::milli>(now-ioStart).count();
+  ioStart = now;
+  return dt;
+}
+}
+
+void BlockFitter::
+voxelize(LabeledCloud& oCloud) const {
+  // same output as pcl::VoxelGrid: the centroid of each occupied voxel,
+  // ordered by voxel index
+  const float* coords[3] = {mPointsX, mPointsY, mPointsZ};
+  auto isFinite = [&](const int iIndex) {
+    return std::isfinite(mPointsX[iIndex]) && std::isfinite(mPointsY[iIndex]) &&
+      std::isfinite(mPointsZ[iIndex]);
+  };
+  // no downsampling: the points are labelled with their index
+  if (mDownsampleResolution <= 0) {
+    for (int i = 0; i < mNumPoints; ++i) {
+      if (!isFinite(i)) continue;
+      Point pt;
+      pt.x = mPointsX[i];
+      pt.y = mPointsY[i];
+      pt.z = mPointsZ[i];
+      pt.label = i;
+      oCloud.push_back(pt);
+    }
+    return;
+  }
+  const float invRes = 1/mDownsampleResolution;
+  Eigen::Vector3f minPt = Eigen::Vector3f::Constant(1e10);
+  Eigen::Vector3f maxPt = Eigen::Vector3f::Constant(-1e10);
+  for (int i = 0; i < mNumPoints; ++i) {
+    if (!isFinite(i)) continue;
+    Eigen::Vector3f p(mPointsX[i], mPointsY[i], mPointsZ[i]);
+    minPt = minPt.cwiseMin(p);
+    maxPt = maxPt.cwiseMax(p);
+  }
+  if (minPt[0] > maxPt[0]) return;
+
+  int64_t minIdx[3], mult[3];
+  for (int k = 0; k < 3; ++k) {
+    minIdx[k] = std::floor(minPt[k]*invRes);
+  }
+  mult[0] = 1;
+  mult[1] = std::floor(maxPt[0]*invRes) - minIdx[0] + 1;
+  mult[2] = mult[1]*(std::floor(maxPt[1]*invRes) - minIdx[1] + 1);
+  std::vector<std::pair<int64_t,int>> keys;
+  keys.reserve(mNumPoints);
+  for (int i = 0; i < mNumPoints; ++i) {
+    if (!isFinite(i)) continue;
+    int64_t key = 0;
+    for (int k = 0; k < 3; ++k) {
+      key += ((int64_t)std::floor(coords[k][i]*invRes) - minIdx[k])*mult[k];
+    }
+    keys.emplace_back(key, i);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  for (size_t i = 0; i < keys.size();) {
+    Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+    size_t j = i;
+    for (; (j < keys.size()) && (keys[j].first == keys[i].first); ++j) {
+      const int idx = keys[j].second;
+      sum += Eigen::Vector3f(mPointsX[idx], mPointsY[idx], mPointsZ[idx]);
+    }
+    Point pt;
+    pt.getVector3fMap() = sum/(j-i);
+    pt.label = 0;
+    oCloud.push_back(pt);
+    i = j;
+  }
+}
+
 BlockFitter::Result BlockFitter::
 go() {
   Result result;
   result.mSuccess = false;
+  result.mTimedOut = false;
+  auto tStart = std::chrono::high_resolution_clock::now();
+  auto tStage = tStart;
+  // early returns keep the timings of the stages reached so far
+  auto finish = [&result, &tStart]() -> const Result& {
+    result.mTimings.mTotal = elapsedMilliseconds(tStart);
+    return result;
+  };
+  const auto tBegin = tStart;
+  auto outOfTime = [this, &result, tBegin]() {
+    if (mTimeBudget <= 0) return false;
+    auto now = std::chrono::high_resolution_clock::now();
+    result.mTimedOut =
+      (std::chrono::duration<float,std::milli>(now-tBegin).count() > mTimeBudget);
+    return result.mTimedOut;
+  };
 
-  if (mCloud->size() < 100) return result;
+  const int numInputPoints = (mCloud ? (int)mCloud->size() : mNumPoints);
+  if (numInputPoints < 100) return finish();
 
   // voxelize
   LabeledCloud::Ptr cloud(new LabeledCloud());
   pcl::VoxelGrid<pcl::PointXYZL> voxelGrid;
-  voxelGrid.setInputCloud(mCloud);
-  voxelGrid.setLeafSize(mDownsampleResolution, mDownsampleResolution,
-                        mDownsampleResolution);
-  voxelGrid.filter(*cloud);
+  const bool keepInputLabels = (mDownsampleResolution <= 0);
+  if (mCloud && !keepInputLabels) {
+    voxelGrid.setInputCloud(mCloud);
+    voxelGrid.setLeafSize(mDownsampleResolution, mDownsampleResolution,
+                          mDownsampleResolution);
+    voxelGrid.filter(*cloud);
+  }
+  else if (mCloud) {
+    for (const auto& pt : mCloud->points) {
+      if (pt.getVector3fMap().allFinite()) cloud->push_back(pt);
+    }
+  }
+  else {
+    voxelize(*cloud);
+  }
+  std::vector<uint32_t> inputLabels;
+  if (keepInputLabels) {
+    inputLabels.resize(cloud->size());
+    for (int i = 0; i < (int)cloud->size(); ++i) {
+      inputLabels[i] = cloud->points[i].label;
+    }
+  }
   for (int i = 0; i < (int)cloud->size(); ++i) cloud->points[i].label = i;
+  result.mTimings.mVoxelize = elapsedMilliseconds(tStage);
+  if (outOfTime()) return finish();
 
   if (mDebug) {
-    std::cout << "Original cloud size " << mCloud->size() << std::endl;
+    std::cout << "Original cloud size " << numInputPoints << std::endl;
     std::cout << "Voxelized cloud size " << cloud->size() << std::endl;
     pcl::io::savePCDFileBinary("cloud_full.pcd", *cloud);
   }
 
-  if (cloud->size() < 100) return result;
+  if (cloud->size() < 100) return finish();
 
   // pose
   cloud->sensor_origin_.head<3>() = mOrigin;
@@ -168,7 +309,7 @@ go() {
     voxelGrid.setLeafSize(0.1, 0.1, 0.1);
     voxelGrid.filter(*tempCloud);
 
-    if (tempCloud->size() < 100) return result;
+    if (tempCloud->size() < 100) return finish();
 
     // find ground plane
     std::vector<Eigen::Vector3f> pts(tempCloud->size());
@@ -179,6 +320,11 @@ go() {
     PlaneFitter planeFitter;
     planeFitter.setMaxDistance(kGroundPlaneDistanceThresh);
     planeFitter.setRefineUsingInliers(true);
+    // the ground is roughly horizontal, one point per hypothesis is enough;
+    // the local optimisation then needs more refits to leave the prior
+    planeFitter.setLocalOptimization(true, 20);
+    planeFitter.setNormalPrior(Eigen::Vector3f::UnitZ(), 30*M_PI/180);
+    planeFitter.setPriorNormalSampling(true);
     auto res = planeFitter.go(pts);
     groundPlane = res.mPlane;
     if (groundPlane[2] < 0) groundPlane = -groundPlane;
@@ -235,23 +381,65 @@ go() {
     }
   }
 
+  result.mTimings.mGroundRemoval = elapsedMilliseconds(tStage);
+  if (outOfTime()) return finish();
+
   // normal estimation
+  const float normalRadius = 0.1;
+  const float maxEstimationError = 0.01;
+  const float maxCenterError = 0.02;
+  const int maxNormalIterations = 100;
+  const float segmenterRadius = 0.03;
+
+  // the cache key covers every setting that changes the normals and neighbors
+  NormalsCache cache;
+  cache.setDirectory(mCacheDirectory);
+  uint64_t cacheKey = 0;
+  NormalsCache::NeighborLists cachedNeighbors;
+  NormalCloud::Ptr normals(new NormalCloud());
+  bool cached = false;
+  if (cache.isEnabled()) {
+    cacheKey = NormalsCache::computeKey
+      (*cloud, {normalRadius, maxEstimationError, maxCenterError,
+                (float)maxNormalIterations, mMaxAngleFromHorizontal,
+                segmenterRadius});
+    cached = cache.load(cacheKey, *normals, cachedNeighbors) &&
+      (normals->size() == cloud->size());
+  }
+
   auto t0 = std::chrono::high_resolution_clock::now();
-  if (mDebug) {
-    std::cout << "computing normals..." << std::flush;
+  if (!cached) {
+    if (mDebug) {
+      std::cout << "computing normals..." << std::flush;
+    }
+    RobustNormalEstimator normalEstimator;
+    normalEstimator.setMaxEstimationError(maxEstimationError);
+    normalEstimator.setRadius(normalRadius);
+    normalEstimator.setMaxCenterError(maxCenterError);
+    normalEstimator.setMaxIterations(maxNormalIterations);
+    // the estimation is the longest stage, it also stops at the budget
+    if (mTimeBudget > 0) {
+      auto now = std::chrono::high_resolution_clock::now();
+      float spent = std::chrono::duration<float,std::milli>(now-tBegin).count();
+      normalEstimator.setTimeBudget(std::max(1e-3f, mTimeBudget - spent));
+    }
+    if (!normalEstimator.go(cloud, *normals)) {
+      result.mTimings.mNormals = elapsedMilliseconds(tStage);
+      result.mTimedOut = true;
+      return finish();
+    }
+    if (mDebug) {
+      auto t1 = std::chrono::high_resolution_clock::now();
+      auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(t1-t0);
+      std::cout << "finished in " << dt.count()/1e3 << " sec" << std::endl;
+    }
   }
-  RobustNormalEstimator normalEstimator;
-  normalEstimator.setMaxEstimationError(0.01);
-  normalEstimator.setRadius(0.1);
-  normalEstimator.setMaxCenterError(0.02);
-  normalEstimator.setMaxIterations(100);
-  NormalCloud::Ptr normals(new NormalCloud());
-  normalEstimator.go(cloud, *normals);
-  if (mDebug) {
-    auto t1 = std::chrono::high_resolution_clock::now();
-    auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(t1-t0);
-    std::cout << "finished in " << dt.count()/1e3 << " sec" << std::endl;
+  else if (mDebug) {
+    std::cout << "normals read from " << mCacheDirectory << std::endl;
   }
+  result.mTimings.mNormals = elapsedMilliseconds(tStage);
+  if (outOfTime()) return finish();
+  const NormalCloud::Ptr allNormals = normals;
 
   // filter non-horizontal points
   const float maxNormalAngle = mMaxAngleFromHorizontal*M_PI/180;
@@ -286,7 +474,18 @@ go() {
   // I think its because the RGB-D map can be curved
   segmenter.setMaxAngle(mMaxAngleOfPlaneSegmenter);
   segmenter.setMinPoints(100);
+  segmenter.setSearchRadius(segmenterRadius);
+  if (cached && (cachedNeighbors.size() == cloud->size())) {
+    segmenter.setNeighbors(cachedNeighbors);
+  }
   PlaneSegmenter::Result segmenterResult = segmenter.go();
+  result.mTimings.mSegmentation = elapsedMilliseconds(tStage);
+  if (outOfTime()) return finish();
+  if (cache.isEnabled() && !cached &&
+      !cache.save(cacheKey, *allNormals, segmenter.getNeighbors())) {
+    std::cout << "BlockFitter: cannot write the normals to " <<
+      mCacheDirectory << std::endl;
+  }
   if (mDebug) {
     auto t1 = std::chrono::high_resolution_clock::now();
     auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(t1-t0);
@@ -308,14 +507,19 @@ go() {
 
   // create point clouds
   std::unordered_map<int,std::vector<Eigen::Vector3f>> cloudMap;
+  std::unordered_map<int,std::vector<uint32_t>> inputLabelMap;
   for (int i = 0; i < (int)segmenterResult.mLabels.size(); ++i) {
     int label = segmenterResult.mLabels[i];
     if (label <= 0) continue;
     cloudMap[label].push_back(cloud->points[i].getVector3fMap());
+    if (keepInputLabels) {
+      inputLabelMap[label].push_back(inputLabels[cloud->points[i].label]);
+    }
   }
   struct Plane {
     MatrixX3f mPoints;
     Eigen::Vector4f mPlane;
+    std::vector<uint32_t> mInputLabels;
   };
   std::vector<Plane> planes;
   planes.reserve(cloudMap.size());
@@ -325,11 +529,14 @@ go() {
     plane.mPoints.resize(n,3);
     for (int i = 0; i < n; ++i) plane.mPoints.row(i) = it.second[i];
     plane.mPlane = segmenterResult.mPlanes[it.first];
+    if (keepInputLabels) std::swap(plane.mInputLabels, inputLabelMap[it.first]);
     planes.push_back(plane);
   }
 
   std::vector<RectangleFitter::Result> results;
+  // past the budget the blocks fitted so far are returned
   for (auto& plane : planes) {
+    if (outOfTime()) break;
     RectangleFitter fitter;
     fitter.setDimensions(mBlockDimensions.head<2>());
     fitter.setAlgorithm((RectangleFitter::Algorithm)mRectangleFitAlgorithm);
@@ -384,12 +591,14 @@ go() {
     block.mPose.translation() -=
       block.mPose.rotation().col(2)*mBlockDimensions[2]/2;
     block.mHull = res.mConvexHull;
+    block.mInputLabels = planes[i].mInputLabels;
     result.mBlocks.push_back(block);
   }
+  result.mTimings.mRectangles = elapsedMilliseconds(tStage);
   if (mDebug) {
     std::cout << "Surviving blocks: " << result.mBlocks.size() << std::endl;
   }
 
   result.mSuccess = true;
-  return result;
+  return finish();
 }
@@ -0,0 +1,142 @@
+#include "plane_seg/MappedCloud.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace planeseg;
+
+namespace {
+const char kMagic[8] = {'P','S','C','L','O','U','D','\0'};
+const uint32_t kVersion = 1;
+}
+
+bool planeseg::
+writeCloudFile(const std::string& iFile, const LabeledCloud& iCloud,
+               const Eigen::Vector3f& iOrigin,
+               const Eigen::Vector3f& iLookDir) {
+  std::vector<float> x, y, z;
+  x.reserve(iCloud.size());
+  y.reserve(iCloud.size());
+  z.reserve(iCloud.size());
+  Eigen::Vector3f minPt = Eigen::Vector3f::Zero();
+  Eigen::Vector3f maxPt = Eigen::Vector3f::Zero();
+  for (const auto& p : iCloud.points) {
+    if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+      continue;
+    }
+    Eigen::Vector3f pt(p.x, p.y, p.z);
+    if (x.empty()) minPt = maxPt = pt;
+    minPt = minPt.cwiseMin(pt);
+    maxPt = maxPt.cwiseMax(pt);
+    x.push_back(p.x);
+    y.push_back(p.y);
+    z.push_back(p.z);
+  }
+
+  CloudFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.mMagic, kMagic, sizeof(kMagic));
+  header.mVersion = kVersion;
+  header.mNumPoints = x.size();
+  for (int k = 0; k < 3; ++k) {
+    header.mMinPoint[k] = minPt[k];
+    header.mMaxPoint[k] = maxPt[k];
+    header.mOrigin[k] = iOrigin[k];
+    header.mLookDir[k] = iLookDir[k];
+  }
+
+  std::ofstream ofs(iFile, std::ios::binary);
+  if (!ofs.is_open()) return false;
+  ofs.write((const char*)&header, sizeof(header));
+  for (const auto* array : {&x, &y, &z}) {
+    ofs.write((const char*)array->data(), array->size()*sizeof(float));
+  }
+  return ofs.good();
+}
+
+MappedCloud::
+MappedCloud() {
+  mData = NULL;
+  mDataSize = 0;
+  mHeader = NULL;
+  mX = mY = mZ = NULL;
+}
+
+MappedCloud::
+~MappedCloud() {
+  close();
+}
+
+bool MappedCloud::
+open(const std::string& iFile) {
+  close();
+  int fd = ::open(iFile.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat info;
+  if ((fstat(fd, &info) != 0) || (info.st_size < (off_t)sizeof(CloudFileHeader))) {
+    ::close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);  // the mapping keeps the file referenced
+  if (data == MAP_FAILED) return false;
+
+  const CloudFileHeader* header = (const CloudFileHeader*)data;
+  const size_t n = header->mNumPoints;
+  if ((std::memcmp(header->mMagic, kMagic, sizeof(kMagic)) != 0) ||
+      (header->mVersion != kVersion) ||
+      ((size_t)info.st_size != sizeof(CloudFileHeader) + 3*n*sizeof(float))) {
+    std::cout << "MappedCloud: " << iFile << " is not a valid cloud file" <<
+      std::endl;
+    munmap(data, info.st_size);
+    return false;
+  }
+  // the voxelization reads the points in the order of their voxel keys,
+  // all over the file: ask for it to be paged in ahead instead
+  madvise(data, info.st_size, MADV_WILLNEED);
+
+  mData = data;
+  mDataSize = info.st_size;
+  mHeader = header;
+  mX = (const float*)(header+1);
+  mY = mX + n;
+  mZ = mY + n;
+  return true;
+}
+
+void MappedCloud::
+close() {
+  if (mData != NULL) munmap(mData, mDataSize);
+  mData = NULL;
+  mDataSize = 0;
+  mHeader = NULL;
+  mX = mY = mZ = NULL;
+}
+
+Eigen::Vector3f MappedCloud::
+getMinPoint() const {
+  return Eigen::Vector3f(mHeader->mMinPoint);
+}
+
+Eigen::Vector3f MappedCloud::
+getMaxPoint() const {
+  return Eigen::Vector3f(mHeader->mMaxPoint);
+}
+
+Eigen::Vector3f MappedCloud::
+getOrigin() const {
+  return Eigen::Vector3f(mHeader->mOrigin);
+}
+
+Eigen::Vector3f MappedCloud::
+getLookDir() const {
+  return Eigen::Vector3f(mHeader->mLookDir);
+}
@@ -0,0 +1,145 @@
+#include "plane_seg/NormalsCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace planeseg;
+
+namespace {
+const char kMagic[8] = {'P','S','N','O','R','M','S','\0'};
+const uint32_t kVersion = 1;
+
+struct FileHeader {
+  char mMagic[8];
+  uint32_t mVersion;
+  uint32_t mNumNormals;
+  uint64_t mKey;
+  uint32_t mNumNeighborLists;
+  uint32_t mNumNeighbors;
+};
+
+void hashBytes(const void* iData, const size_t iSize, uint64_t& ioHash) {
+  const unsigned char* bytes = (const unsigned char*)iData;
+  for (size_t i = 0; i < iSize; ++i) {
+    ioHash ^= bytes[i];
+    ioHash *= 1099511628211ULL;
+  }
+}
+}
+
+NormalsCache::
+NormalsCache() {
+}
+
+void NormalsCache::
+setDirectory(const std::string& iDir) {
+  mDirectory = iDir;
+}
+
+uint64_t NormalsCache::
+computeKey(const LabeledCloud& iCloud, const std::vector<float>& iParams) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const auto& p : iCloud.points) {
+    const float xyz[3] = {p.x, p.y, p.z};
+    hashBytes(xyz, sizeof(xyz), hash);
+  }
+  hashBytes(iParams.data(), iParams.size()*sizeof(float), hash);
+  return hash;
+}
+
+std::string NormalsCache::
+getFileName(const uint64_t iKey) const {
+  std::ostringstream oss;
+  oss << mDirectory << "/normals_" << std::hex << std::setw(16) <<
+    std::setfill('0') << iKey << ".bin";
+  return oss.str();
+}
+
+bool NormalsCache::
+load(const uint64_t iKey, NormalCloud& oNormals,
+     NeighborLists& oNeighbors) const {
+  if (!isEnabled()) return false;
+  std::ifstream ifs(getFileName(iKey), std::ios::binary);
+  if (!ifs.is_open()) return false;
+  FileHeader header;
+  ifs.read((char*)&header, sizeof(header));
+  if (!ifs.good() || (std::memcmp(header.mMagic, kMagic, sizeof(kMagic)) != 0) ||
+      (header.mVersion != kVersion) || (header.mKey != iKey)) return false;
+
+  // normal_x, normal_y, normal_z, curvature per point
+  std::vector<float> normals(4*header.mNumNormals);
+  ifs.read((char*)normals.data(), normals.size()*sizeof(float));
+  // neighbor lists stored as offsets into one index array
+  std::vector<uint32_t> offsets(header.mNumNeighborLists+1);
+  ifs.read((char*)offsets.data(), offsets.size()*sizeof(uint32_t));
+  std::vector<int32_t> indices(header.mNumNeighbors);
+  ifs.read((char*)indices.data(), indices.size()*sizeof(int32_t));
+  if (!ifs.good()) return false;
+
+  oNormals.width = header.mNumNormals;
+  oNormals.height = 0;
+  oNormals.resize(header.mNumNormals);
+  oNormals.is_dense = false;
+  for (int i = 0; i < (int)header.mNumNormals; ++i) {
+    auto& norm = oNormals.points[i];
+    norm.normal_x = normals[4*i];
+    norm.normal_y = normals[4*i+1];
+    norm.normal_z = normals[4*i+2];
+    norm.curvature = normals[4*i+3];
+  }
+  oNeighbors.resize(header.mNumNeighborLists);
+  for (int i = 0; i < (int)header.mNumNeighborLists; ++i) {
+    if ((offsets[i] > offsets[i+1]) || (offsets[i+1] > header.mNumNeighbors)) {
+      return false;
+    }
+    oNeighbors[i].assign(indices.begin()+offsets[i],
+                         indices.begin()+offsets[i+1]);
+  }
+  return true;
+}
+
+bool NormalsCache::
+save(const uint64_t iKey, const NormalCloud& iNormals,
+     const NeighborLists& iNeighbors) const {
+  if (!isEnabled()) return false;
+  std::vector<float> normals;
+  normals.reserve(4*iNormals.size());
+  for (const auto& norm : iNormals.points) {
+    normals.push_back(norm.normal_x);
+    normals.push_back(norm.normal_y);
+    normals.push_back(norm.normal_z);
+    normals.push_back(norm.curvature);
+  }
+  std::vector<uint32_t> offsets(1, 0);
+  std::vector<int32_t> indices;
+  for (const auto& neighbors : iNeighbors) {
+    indices.insert(indices.end(), neighbors.begin(), neighbors.end());
+    offsets.push_back(indices.size());
+  }
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.mMagic, kMagic, sizeof(kMagic));
+  header.mVersion = kVersion;
+  header.mNumNormals = iNormals.size();
+  header.mKey = iKey;
+  header.mNumNeighborLists = iNeighbors.size();
+  header.mNumNeighbors = indices.size();
+
+  // written under a temporary name so that a reader never sees half a file
+  const std::string fileName = getFileName(iKey);
+  const std::string tempName = fileName + ".tmp";
+  {
+    std::ofstream ofs(tempName, std::ios::binary);
+    if (!ofs.is_open()) return false;
+    ofs.write((const char*)&header, sizeof(header));
+    ofs.write((const char*)normals.data(), normals.size()*sizeof(float));
+    ofs.write((const char*)offsets.data(), offsets.size()*sizeof(uint32_t));
+    ofs.write((const char*)indices.data(), indices.size()*sizeof(int32_t));
+    if (!ofs.good()) return false;
+  }
+  return std::rename(tempName.c_str(), fileName.c_str()) == 0;
+}
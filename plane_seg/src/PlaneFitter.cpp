@@ -30,6 +30,36 @@ struct SimpleProblemBase {
   int getSampleSize() const { return 3; }
   int getNumDataPoints() const { return mPoints.rows(); }
 
+  // collinear or coincident points do not define a plane
+  static bool isNonDegenerate(const Eigen::Vector3f& iP1,
+                              const Eigen::Vector3f& iP2,
+                              const Eigen::Vector3f& iP3) {
+    const Eigen::Vector3f a = iP2-iP1;
+    const Eigen::Vector3f b = iP3-iP1;
+    return a.cross(b).norm() > 1e-3f*a.norm()*b.norm();
+  }
+
+  bool isSampleValid(const std::vector<int>& iIndices) const {
+    if (iIndices.size() != 3) return true;
+    return isNonDegenerate(mPoints.row(iIndices[0]), mPoints.row(iIndices[1]),
+                           mPoints.row(iIndices[2]));
+  }
+
+  bool isModelValid(const Solution& iSolution) const {
+    const auto& plane = iSolution.mPlane;
+    if (!plane.allFinite()) return false;
+    // minimal planes must pass near the center point, if there is one
+    if ((iSolution.mCurvature == 0) && mCenterPoint.allFinite()) {
+      float centerDist = plane.head<3>().dot(mCenterPoint) + plane[3];
+      if (std::abs(centerDist) > 0.02f) return false;
+    }
+    if (mCheckNormal) {
+      float dot = std::abs(plane.head<3>().dot(mNormalPrior));
+      if (dot < std::cos(mMaxAngleDeviation)) return false;
+    }
+    return true;
+  }
+
   Solution estimate(const std::vector<int>& iIndices) const {
     Solution sol;
     const int n = iIndices.size();
@@ -40,8 +70,6 @@ struct SimpleProblemBase {
       sol.mPlane.head<3>() = ((p3-p1).cross(p2-p1)).normalized();
       sol.mPlane[3] = -sol.mPlane.head<3>().dot(p1);
       sol.mCurvature = 0;
-      float centerDist = sol.mPlane.head<3>().dot(mCenterPoint) + sol.mPlane[3];
-      if (std::abs(centerDist) > 0.02f)  sol.mPlane[3] = 1e10;
     }
     else {
       sol = estimateFull(iIndices);
@@ -67,12 +95,6 @@ struct SimpleProblemBase {
   std::vector<double> computeSquaredErrors(const Solution& iSolution) const {
     const auto& plane = iSolution.mPlane;
     Eigen::Vector3f normal = plane.head<3>();
-    if (mCheckNormal) {
-      float dot = std::abs(normal.dot(mNormalPrior));
-      if (dot < std::cos(mMaxAngleDeviation)) {
-        return std::vector<double>();
-      }
-    }
     Eigen::VectorXf errors = (mPoints*normal).array() + plane[3];
     std::vector<double> errors2(errors.size());
     for (int i = 0; i < (int)errors2.size(); ++i) {
@@ -88,6 +110,13 @@ struct SimpleProblem : public SimpleProblemBase {
 
   int getSampleSize() const { return 2; }
 
+  // the two points must not be collinear with the center point
+  bool isSampleValid(const std::vector<int>& iIndices) const {
+    if (iIndices.size() != 2) return true;
+    return isNonDegenerate(mPoints.row(iIndices[0]), mPoints.row(iIndices[1]),
+                           mCenterPoint);
+  }
+
   Solution estimate(const std::vector<int>& iIndices) const {
     Solution sol;
     const int n = iIndices.size();
@@ -107,6 +136,41 @@ struct SimpleProblem : public SimpleProblemBase {
 
 };
 
+// the normal is the prior, a single point fixes the offset
+struct PriorNormalProblem : public SimpleProblemBase {
+  PriorNormalProblem(const std::vector<Eigen::Vector3f>& iPoints) :
+    SimpleProblemBase(iPoints) {}
+
+  int getSampleSize() const { return 1; }
+
+  Solution estimate(const std::vector<int>& iIndices) const {
+    Solution sol;
+    const int n = iIndices.size();
+    if (n < 3) {
+      // too few points for a least squares plane: the prior through their
+      // centroid (a single point for the minimal samples)
+      Eigen::Vector3f center = Eigen::Vector3f::Zero();
+      for (const int idx : iIndices) center += mPoints.row(idx).transpose();
+      center /= n;
+      sol.mPlane.head<3>() = mNormalPrior;
+      sol.mPlane[3] = -mNormalPrior.dot(center);
+      sol.mCurvature = 0;
+      sol.mCenterPoint = center;
+    }
+    else {
+      // least squares refit, kept within the allowed deviation from the prior
+      sol = estimateFull(iIndices);
+      Eigen::Vector3f normal = sol.mPlane.head<3>();
+      float dot = std::abs(normal.dot(mNormalPrior));
+      if (!normal.allFinite() || (dot < std::cos(mMaxAngleDeviation))) {
+        sol.mPlane.head<3>() = mNormalPrior;
+        sol.mPlane[3] = -mNormalPrior.dot(sol.mCenterPoint);
+      }
+    }
+    return sol;
+  }
+};
+
 }
 
 
@@ -115,6 +179,10 @@ PlaneFitter() {
   setMaxDistance(0.01);
   setMaxIterations(100);
   setRefineUsingInliers(true);
+  setOrderedSampling(false);
+  setLocalOptimization(false);
+  setScoring(ScoringInlierCount);
+  setPriorNormalSampling(false);
   float badValue = std::numeric_limits<float>::infinity();
   setCenterPoint(Eigen::Vector3f(badValue, badValue, badValue));
   setNormalPrior(Eigen::Vector3f(0,0,0), 2*M_PI);
@@ -145,6 +213,27 @@ setRefineUsingInliers(const bool iVal) {
   mRefineUsingInliers = iVal;
 }
 
+void PlaneFitter::
+setOrderedSampling(const bool iVal) {
+  mOrderedSampling = iVal;
+}
+
+void PlaneFitter::
+setLocalOptimization(const bool iVal, const int iNumRefits) {
+  mLocalOptimization = iVal;
+  mNumLocalRefits = iNumRefits;
+}
+
+void PlaneFitter::
+setScoring(const Scoring iScoring) {
+  mScoring = iScoring;
+}
+
+void PlaneFitter::
+setPriorNormalSampling(const bool iVal) {
+  mPriorNormalSampling = iVal;
+}
+
 void PlaneFitter::
 setNormalPrior(const Eigen::Vector3f& iNormal,
                const float iMaxAngleDeviation) {
@@ -156,19 +245,42 @@ setNormalPrior(const Eigen::Vector3f& iNormal,
 
 PlaneFitter::Result PlaneFitter::
 go(const std::vector<Eigen::Vector3f>& iPoints) const {
+  if (mPriorNormalSampling && mCheckNormal) {
+    return solve<PriorNormalProblem>(iPoints);
+  }
   if (std::isinf(mCenterPoint[0])) return solve<SimpleProblemBase>(iPoints);
   else return solve<SimpleProblem>(iPoints);
 }
 
+// the scoring is a template parameter of the solver, chosen once here
 template<typename T>
 PlaneFitter::Result PlaneFitter::
+solve(const std::vector<Eigen::Vector3f>& iPoints) const {
+  switch (mScoring) {
+  case ScoringMsac: return solve<T,drc::MsacScoring>(iPoints);
+  case ScoringMlesac: return solve<T,drc::MlesacScoring>(iPoints);
+  default: return solve<T,drc::InlierCountScoring>(iPoints);
+  }
+}
+
+template<typename T, typename S>
+PlaneFitter::Result PlaneFitter::
 solve(const std::vector<Eigen::Vector3f>& iPoints) const {
   Result result;
-  drc::RansacGeneric<T> ransac;
+  drc::RansacGeneric<T,S> ransac;
   ransac.setMaximumError(mMaxDistance);
   ransac.setRefineUsingInliers(mRefineUsingInliers);
   ransac.setMaximumIterations(mMaxIterations);
   ransac.setSkippedIterationFactor(mSkippedIterationFactor);
+  ransac.setOrderedSampling(mOrderedSampling);
+  if (mPriorNormalSampling && mCheckNormal) {
+    // the hypotheses are only as tilted as the prior, the refits of the local
+    // optimisation are what brings them onto the actual plane
+    ransac.setLocalOptimization(true, 10, 7, mNumLocalRefits);
+  }
+  else {
+    ransac.setLocalOptimization(mLocalOptimization, 10, 7, mNumLocalRefits);
+  }
 
   T problem(iPoints);
   problem.mCenterPoint = mCenterPoint;
@@ -20,6 +20,7 @@ setData(const LabeledCloud::Ptr& iCloud,
         const NormalCloud::Ptr& iNormals) {
   mCloud = iCloud;
     mNormals = iNormals;
+  mNeighbors.clear();
 }
 
 void PlaneSegmenter::
@@ -43,33 +44,46 @@ setMinPoints(const int iMin) {
   mMinPoints = iMin;
 }
 
+void PlaneSegmenter::
+setNeighbors(const std::vector<std::vector<int>>& iNeighbors) {
+  mNeighbors = iNeighbors;
+}
+
+const std::vector<std::vector<int>>& PlaneSegmenter::
+getNeighbors() const {
+  return mNeighbors;
+}
+
 PlaneSegmenter::Result PlaneSegmenter::
 go() {
   Result result;
   const int n = mCloud->size();
 
   // create kdtree and get nearest neighbors list
-  pcl::search::KdTree<Point>::Ptr tree
-    (new pcl::search::KdTree<Point>());
-  tree->setInputCloud(mCloud);
-  std::vector<std::vector<int>> neighbors(n);
-  std::vector<float> distances;
-  for (int i = 0; i < n; ++i) { 
-    tree->radiusSearch(i, mSearchRadius, neighbors[i], distances);
-    auto& neigh = neighbors[i];
-    std::vector<std::pair<int,float>> pairs(neigh.size());
-    for (int j = 0; j < (int)neigh.size(); ++j) {
-      pairs[j].first = neigh[j];
-      pairs[j].second = distances[j];
-    }
-    std::sort(pairs.begin(), pairs.end(),
-              [](const std::pair<int,float>& iA,
-                 const std::pair<int,float>& iB){
-                return iA.second<iB.second;});
-    for (int j = 0; j < (int)neigh.size(); ++j) {
-      neigh[j] = pairs[j].first;
+  if ((int)mNeighbors.size() != n) {
+    pcl::search::KdTree<Point>::Ptr tree
+      (new pcl::search::KdTree<Point>());
+    tree->setInputCloud(mCloud);
+    mNeighbors.resize(n);
+    std::vector<float> distances;
+    for (int i = 0; i < n; ++i) {
+      tree->radiusSearch(i, mSearchRadius, mNeighbors[i], distances);
+      auto& neigh = mNeighbors[i];
+      std::vector<std::pair<int,float>> pairs(neigh.size());
+      for (int j = 0; j < (int)neigh.size(); ++j) {
+        pairs[j].first = neigh[j];
+        pairs[j].second = distances[j];
+      }
+      std::sort(pairs.begin(), pairs.end(),
+                [](const std::pair<int,float>& iA,
+                   const std::pair<int,float>& iB){
+                  return iA.second<iB.second;});
+      for (int j = 0; j < (int)neigh.size(); ++j) {
+        neigh[j] = pairs[j].first;
+      }
     }
   }
+  const std::vector<std::vector<int>>& neighbors = mNeighbors;
 
   // hitmask
   std::vector<bool> hitMask(n);
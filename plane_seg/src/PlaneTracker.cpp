@@ -0,0 +1,161 @@
+#include "plane_seg/PlaneTracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+using namespace planeseg;
+
+namespace {
+// largest distance from a vertex of iA to the outline of iB
+float hullDistance(const std::vector<Eigen::Vector3f>& iA,
+                   const std::vector<Eigen::Vector3f>& iB) {
+  float maxDist = 0;
+  for (const auto& p : iA) {
+    float minDist = 1e10;
+    for (size_t j = 0; j < iB.size(); ++j) {
+      const Eigen::Vector3f& a = iB[j];
+      const Eigen::Vector3f ab = iB[(j+1)%iB.size()] - a;
+      const float len2 = ab.squaredNorm();
+      const float t = (len2 > 0) ?
+        std::min(1.0f, std::max(0.0f, (p-a).dot(ab)/len2)) : 0;
+      minDist = std::min(minDist, (a + t*ab - p).norm());
+    }
+    maxDist = std::max(maxDist, minDist);
+  }
+  return maxDist;
+}
+}
+
+PlaneTracker::
+PlaneTracker() {
+  setMatchThresholds(10, 0.05, 0.5);
+  setChangeTolerance(0.02);
+  reset();
+}
+
+void PlaneTracker::
+setMatchThresholds(const float iMaxAngle, const float iMaxOffset,
+                   const float iMaxDistance) {
+  mMaxAngle = iMaxAngle*M_PI/180;
+  mMaxOffset = iMaxOffset;
+  mMaxDistance = iMaxDistance;
+}
+
+void PlaneTracker::
+setChangeTolerance(const float iDist) {
+  mChangeTolerance = iDist;
+}
+
+void PlaneTracker::
+reset() {
+  mTracks.clear();
+  mNextId = 1;
+}
+
+bool PlaneTracker::
+hasChanged(const Track& iOld, const Track& iNew) const {
+  // the hulls are compared as outlines, whatever their vertex count and order
+  if (std::abs(iOld.mPlane.head<3>().dot(iNew.mCentroid) + iOld.mPlane[3]) >
+      mChangeTolerance) return true;
+  if (iOld.mHull.empty() || iNew.mHull.empty()) {
+    return iOld.mHull.size() != iNew.mHull.size();
+  }
+  return (hullDistance(iOld.mHull, iNew.mHull) > mChangeTolerance) ||
+    (hullDistance(iNew.mHull, iOld.mHull) > mChangeTolerance);
+}
+
+std::vector<PlaneTracker::Plane> PlaneTracker::
+update(const std::vector<BlockFitter::Block>& iBlocks) {
+  std::vector<Track> tracks;
+  tracks.reserve(iBlocks.size());
+  for (const auto& block : iBlocks) {
+    Track track;
+    track.mHull = block.mHull;
+    track.mCentroid = block.mPose.translation();
+    if (!block.mHull.empty()) {
+      track.mCentroid.setZero();
+      for (const auto& p : block.mHull) track.mCentroid += p;
+      track.mCentroid /= block.mHull.size();
+    }
+    Eigen::Vector3f normal = block.mPose.rotation().col(2);
+    if (normal[2] < 0) normal = -normal;
+    track.mPlane << normal, -normal.dot(track.mCentroid);
+    tracks.push_back(track);
+  }
+
+  // all the compatible pairs of new and previous planes, the closest pairs
+  // are matched first so that the result does not depend on the input order
+  const float minCos = std::cos(mMaxAngle);
+  std::vector<std::tuple<float,int,int>> pairs;
+  for (int i = 0; i < (int)tracks.size(); ++i) {
+    const auto& track = tracks[i];
+    for (int j = 0; j < (int)mTracks.size(); ++j) {
+      const auto& old = mTracks[j];
+      if (old.mPlane.head<3>().dot(track.mPlane.head<3>()) < minCos) continue;
+      if (std::abs(old.mPlane.head<3>().dot(track.mCentroid) + old.mPlane[3]) >
+          mMaxOffset) continue;
+      float dist = (old.mCentroid-track.mCentroid).norm();
+      if (dist <= mMaxDistance) pairs.emplace_back(dist, i, j);
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+  std::vector<int> matches(tracks.size(), -1);
+  std::vector<bool> matched(mTracks.size(), false);
+  for (const auto& pair : pairs) {
+    const int i = std::get<1>(pair);
+    const int j = std::get<2>(pair);
+    if ((matches[i] >= 0) || matched[j]) continue;
+    matches[i] = j;
+    matched[j] = true;
+  }
+
+  // each new plane takes the id of its matching previous plane
+  std::vector<Plane> planes;
+  for (int i = 0; i < (int)tracks.size(); ++i) {
+    auto& track = tracks[i];
+    const int best = matches[i];
+    Plane plane;
+    if (best >= 0) {
+      track.mId = mTracks[best].mId;
+      plane.mStatus = hasChanged(mTracks[best], track) ? Changed : Unchanged;
+      // unchanged planes keep their previous geometry, so that small
+      // variations do not add up to an unreported drift
+      if (plane.mStatus == Unchanged) track = mTracks[best];
+    }
+    else {
+      track.mId = mNextId++;
+      plane.mStatus = Added;
+    }
+    plane.mId = track.mId;
+    plane.mPlane = track.mPlane;
+    plane.mHull = track.mHull;
+    planes.push_back(plane);
+  }
+
+  for (int j = 0; j < (int)mTracks.size(); ++j) {
+    if (matched[j]) continue;
+    Plane plane;
+    plane.mId = mTracks[j].mId;
+    plane.mStatus = Removed;
+    plane.mPlane.setZero();
+    planes.push_back(plane);
+  }
+
+  mTracks = tracks;
+  return planes;
+}
+
+std::vector<PlaneTracker::Plane> PlaneTracker::
+getPlanes() const {
+  std::vector<Plane> planes;
+  for (const auto& track : mTracks) {
+    Plane plane;
+    plane.mId = track.mId;
+    plane.mStatus = Unchanged;
+    plane.mPlane = track.mPlane;
+    plane.mHull = track.mHull;
+    planes.push_back(plane);
+  }
+  return planes;
+}
@@ -1,6 +1,7 @@
 #include "plane_seg/RobustNormalEstimator.hpp"
 
 #include "plane_seg/PlaneFitter.hpp"
+#include <chrono>
 #include <pcl/search/kdtree.h>
 
 #include "plane_seg/Types.hpp"
@@ -14,6 +15,8 @@ RobustNormalEstimator() {
   setMaxCenterError(0.02);
   setMaxIterations(100);
   computeCurvature(true);
+  setOrderedSampling(false);
+  setTimeBudget(0);
 }
 
 void RobustNormalEstimator::
@@ -41,18 +44,30 @@ computeCurvature(const bool iVal) {
   mComputeCurvature = iVal;
 }
 
+void RobustNormalEstimator::
+setOrderedSampling(const bool iVal) {
+  mOrderedSampling = iVal;
+}
+
+void RobustNormalEstimator::
+setTimeBudget(const float iMilliseconds) {
+  mTimeBudget = iMilliseconds;
+}
+
 bool RobustNormalEstimator::
 go(const LabeledCloud::Ptr& iCloud, NormalCloud& oNormals) {
+  const auto tBegin = std::chrono::high_resolution_clock::now();
 
   // plane fitter
   PlaneFitter planeFitter;
   planeFitter.setMaxIterations(mMaxIterations);
   planeFitter.setMaxDistance(mMaxEstimationError);
   planeFitter.setRefineUsingInliers(true);
+  planeFitter.setOrderedSampling(mOrderedSampling);
   std::vector<Eigen::Vector3f> pts;
   pts.reserve(1000);
 
-  // kd tree
+  // kd tree, its neighbors come sorted by distance
   pcl::search::KdTree<Point>::Ptr tree
     (new pcl::search::KdTree<Point>());
   tree->setInputCloud(iCloud);
@@ -68,6 +83,13 @@ go(const LabeledCloud::Ptr& iCloud, NormalCloud& oNormals) {
 
   for (int i = 0; i < n; ++i) {
 
+    // the clock is only read every few hundred points
+    if ((mTimeBudget > 0) && ((i & 255) == 0) && (i > 0)) {
+      auto now = std::chrono::high_resolution_clock::now();
+      if (std::chrono::duration<float,std::milli>(now-tBegin).count() >
+          mTimeBudget) return false;
+    }
+
     tree->radiusSearch(i, mRadius, indices, distances);
     pts.clear();
     for (const auto idx : indices) {
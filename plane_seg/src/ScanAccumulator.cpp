@@ -0,0 +1,108 @@
+#include "plane_seg/ScanAccumulator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace planeseg;
+
+ScanAccumulator::
+ScanAccumulator() {
+  mResolution = 0;
+  setResolution(0.01);
+  setMaxScans(10);
+  setMaxAge(0);
+}
+
+void ScanAccumulator::
+setResolution(const float iRes) {
+  if (iRes != mResolution) clear();
+  mResolution = iRes;
+}
+
+void ScanAccumulator::
+setMaxScans(const int iNum) {
+  mMaxScans = std::max(1, iNum);
+}
+
+void ScanAccumulator::
+setMaxAge(const double iSeconds) {
+  mMaxAge = iSeconds;
+}
+
+uint64_t ScanAccumulator::
+getKey(const Eigen::Vector3f& iPoint) const {
+  // 21 bits per axis, i.e. +/-10 km at 1 cm
+  uint64_t key = 0;
+  for (int k = 0; k < 3; ++k) {
+    const int64_t idx = std::floor(iPoint[k]/mResolution);
+    key = (key << 21) | ((uint64_t)idx & 0x1FFFFF);
+  }
+  return key;
+}
+
+void ScanAccumulator::
+addScan(const LabeledCloud& iCloud, const double iTime) {
+  // contributions of the scan, merged per voxel
+  std::unordered_map<uint64_t,Voxel> scanVoxels;
+  scanVoxels.reserve(iCloud.size());
+  for (const auto& pt : iCloud.points) {
+    const Eigen::Vector3f p = pt.getVector3fMap();
+    if (!p.allFinite()) continue;
+    auto insertion = scanVoxels.insert({getKey(p), Voxel()});
+    Voxel& voxel = insertion.first->second;
+    if (insertion.second) {
+      voxel.mSum = p;
+      voxel.mCount = 1;
+    }
+    else {
+      voxel.mSum += p;
+      ++voxel.mCount;
+    }
+  }
+
+  Scan scan;
+  scan.mTime = iTime;
+  scan.mContributions.assign(scanVoxels.begin(), scanVoxels.end());
+  for (const auto& contribution : scan.mContributions) {
+    auto insertion = mVoxels.insert(contribution);
+    if (!insertion.second) {
+      insertion.first->second.mSum += contribution.second.mSum;
+      insertion.first->second.mCount += contribution.second.mCount;
+    }
+  }
+  mScans.push_back(std::move(scan));
+
+  while ((int)mScans.size() > mMaxScans) evictOldest();
+  while ((mMaxAge > 0) && (mScans.size() > 1) &&
+         (iTime - mScans.front().mTime > mMaxAge)) evictOldest();
+}
+
+void ScanAccumulator::
+evictOldest() {
+  for (const auto& contribution : mScans.front().mContributions) {
+    auto it = mVoxels.find(contribution.first);
+    if (it == mVoxels.end()) continue;
+    it->second.mCount -= contribution.second.mCount;
+    if (it->second.mCount <= 0) mVoxels.erase(it);
+    else it->second.mSum -= contribution.second.mSum;
+  }
+  mScans.pop_front();
+}
+
+void ScanAccumulator::
+getCloud(LabeledCloud& oCloud) const {
+  oCloud.clear();
+  oCloud.reserve(mVoxels.size());
+  for (const auto& it : mVoxels) {
+    Point pt;
+    pt.getVector3fMap() = it.second.mSum/it.second.mCount;
+    pt.label = 0;
+    oCloud.push_back(pt);
+  }
+}
+
+void ScanAccumulator::
+clear() {
+  mVoxels.clear();
+  mScans.clear();
+}
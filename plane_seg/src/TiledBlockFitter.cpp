@@ -0,0 +1,453 @@
+#include "plane_seg/TiledBlockFitter.hpp"
+#include "plane_seg/Geometry.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+
+#include <unistd.h>
+
+using namespace planeseg;
+
+namespace {
+
+typedef std::vector<Eigen::Vector2f> Polygon;
+
+float cross(const Eigen::Vector2f& iA, const Eigen::Vector2f& iB,
+            const Eigen::Vector2f& iC) {
+  return (iB[0]-iA[0])*(iC[1]-iA[1]) - (iB[1]-iA[1])*(iC[0]-iA[0]);
+}
+
+// Andrew's monotone chain, counterclockwise without collinear points
+Polygon convexHull(Polygon ioPoints) {
+  if (ioPoints.size() < 3) return ioPoints;
+  std::sort(ioPoints.begin(), ioPoints.end(),
+            [](const Eigen::Vector2f& iA, const Eigen::Vector2f& iB) {
+              return (iA[0] < iB[0]) || ((iA[0] == iB[0]) && (iA[1] < iB[1]));
+            });
+  Polygon hull(2*ioPoints.size());
+  int k = 0;
+  for (int i = 0; i < (int)ioPoints.size(); ++i) {
+    while ((k >= 2) && (cross(hull[k-2], hull[k-1], ioPoints[i]) <= 0)) --k;
+    hull[k++] = ioPoints[i];
+  }
+  for (int i = (int)ioPoints.size()-2, lower = k+1; i >= 0; --i) {
+    while ((k >= lower) && (cross(hull[k-2], hull[k-1], ioPoints[i]) <= 0)) --k;
+    hull[k++] = ioPoints[i];
+  }
+  hull.resize(k-1);
+  return hull;
+}
+
+float segmentDistance(const Eigen::Vector2f& iPt, const Eigen::Vector2f& iA,
+                      const Eigen::Vector2f& iB) {
+  Eigen::Vector2f ab = iB-iA;
+  float len2 = ab.squaredNorm();
+  float t = (len2 > 0) ? std::min(1.0f, std::max(0.0f, (iPt-iA).dot(ab)/len2)) : 0;
+  return (iA + t*ab - iPt).norm();
+}
+
+bool segmentsIntersect(const Eigen::Vector2f& iA, const Eigen::Vector2f& iB,
+                       const Eigen::Vector2f& iC, const Eigen::Vector2f& iD) {
+  return (cross(iA,iB,iC)*cross(iA,iB,iD) < 0) &&
+    (cross(iC,iD,iA)*cross(iC,iD,iB) < 0);
+}
+
+// distance between two polygons, zero if they overlap
+float polygonDistance(const Polygon& iA, const Polygon& iB) {
+  if (iA.empty() || iB.empty()) return 1e10;
+  if (isInsidePolygon(iA, iB[0]) || isInsidePolygon(iB, iA[0])) return 0;
+  float minDist = 1e10;
+  for (size_t i = 0; i < iA.size(); ++i) {
+    const auto& a0 = iA[i];
+    const auto& a1 = iA[(i+1)%iA.size()];
+    for (size_t j = 0; j < iB.size(); ++j) {
+      const auto& b0 = iB[j];
+      const auto& b1 = iB[(j+1)%iB.size()];
+      if (segmentsIntersect(a0, a1, b0, b1)) return 0;
+      minDist = std::min(minDist, segmentDistance(a0, b0, b1));
+      minDist = std::min(minDist, segmentDistance(b0, a0, a1));
+    }
+  }
+  return minDist;
+}
+
+Polygon projectHull(const BlockFitter::Block& iBlock) {
+  Polygon poly;
+  for (const auto& p : iBlock.mHull) poly.push_back(p.head<2>());
+  return poly;
+}
+
+Eigen::Vector4f blockPlane(const BlockFitter::Block& iBlock) {
+  Eigen::Vector3f normal = iBlock.mPose.rotation().col(2);
+  Eigen::Vector3f center = Eigen::Vector3f::Zero();
+  for (const auto& p : iBlock.mHull) center += p;
+  center /= iBlock.mHull.size();
+  Eigen::Vector4f plane;
+  plane << normal, -normal.dot(center);
+  return plane;
+}
+
+float polygonArea(const Polygon& iPoly) {
+  float area = 0;
+  for (size_t i = 0; i < iPoly.size(); ++i) {
+    const auto& p = iPoly[i];
+    const auto& q = iPoly[(i+1)%iPoly.size()];
+    area += p[0]*q[1] - q[0]*p[1];
+  }
+  return std::abs(area)/2;
+}
+
+int findRoot(std::vector<int>& ioParents, int iIndex) {
+  while (ioParents[iIndex] != iIndex) {
+    ioParents[iIndex] = ioParents[ioParents[iIndex]];
+    iIndex = ioParents[iIndex];
+  }
+  return iIndex;
+}
+
+}
+
+TiledBlockFitter::
+TiledBlockFitter() {
+  setTileSize(10);
+  setTileOverlap(0.5);
+  setMemoryBudget(256*1024*1024);
+  setNumThreads(std::max(1u, std::thread::hardware_concurrency()));
+  setSpillDirectory("/tmp");
+  setMergeThresholds(10, 0.05, 0.1);
+  setDebug(false);
+  mGridOrigin.setZero();
+  mNumTilesX = mNumTilesY = 0;
+}
+
+void TiledBlockFitter::
+setFitter(const BlockFitter& iFitter) {
+  mFitter = iFitter;
+}
+
+void TiledBlockFitter::
+setTileSize(const float iSize) {
+  mTileSize = iSize;
+}
+
+void TiledBlockFitter::
+setTileOverlap(const float iOverlap) {
+  mTileOverlap = iOverlap;
+}
+
+void TiledBlockFitter::
+setMemoryBudget(const size_t iBytes) {
+  mMemoryBudget = iBytes;
+}
+
+void TiledBlockFitter::
+setNumThreads(const int iNum) {
+  mNumThreads = std::max(1, iNum);
+}
+
+void TiledBlockFitter::
+setSpillDirectory(const std::string& iDir) {
+  mSpillDirectory = iDir;
+}
+
+void TiledBlockFitter::
+setMergeThresholds(const float iMaxAngle, const float iMaxOffset,
+                   const float iMaxGap) {
+  mMaxMergeAngle = iMaxAngle*M_PI/180;
+  mMaxMergeOffset = iMaxOffset;
+  mMaxMergeGap = iMaxGap;
+}
+
+void TiledBlockFitter::
+setDebug(const bool iVal) {
+  mDebug = iVal;
+}
+
+bool TiledBlockFitter::
+spillTiles(const MappedCloud& iCloud, const std::string& iDir,
+           std::vector<std::string>& oFiles) const {
+  const int numTiles = mNumTilesX*mNumTilesY;
+  oFiles.resize(numTiles);
+  for (int i = 0; i < numTiles; ++i) {
+    oFiles[i] = iDir + "/tile_" + std::to_string(i) + ".bin";
+  }
+
+  // points are buffered as xyz triples in a fixed share of the budget per
+  // tile (allocated once, with a floor of 1024 points), which is appended
+  // to the tile file whenever it is full
+  const size_t chunkSize =
+    std::max<size_t>(3*1024, mMemoryBudget/numTiles/(3*sizeof(float))*3);
+  std::vector<std::vector<float>> buffers(numTiles);
+  std::vector<bool> created(numTiles, false);
+  auto flush = [&](const int iTile) {
+    auto& buffer = buffers[iTile];
+    if (buffer.empty()) return true;
+    std::ofstream ofs(oFiles[iTile], std::ios::binary |
+                      (created[iTile] ? std::ios::app : std::ios::trunc));
+    if (!ofs.is_open()) return false;
+    ofs.write((const char*)buffer.data(), buffer.size()*sizeof(float));
+    created[iTile] = true;
+    buffer.clear();
+    return ofs.good();
+  };
+
+  const float* x = iCloud.x();
+  const float* y = iCloud.y();
+  const float* z = iCloud.z();
+  for (int i = 0; i < iCloud.size(); ++i) {
+    const float u = (x[i]-mGridOrigin[0])/mTileSize;
+    const float v = (y[i]-mGridOrigin[1])/mTileSize;
+    const float margin = mTileOverlap/mTileSize;
+    const int minU = std::max(0, (int)std::floor(u-margin));
+    const int maxU = std::min(mNumTilesX-1, (int)std::floor(u+margin));
+    const int minV = std::max(0, (int)std::floor(v-margin));
+    const int maxV = std::min(mNumTilesY-1, (int)std::floor(v+margin));
+    for (int tv = minV; tv <= maxV; ++tv) {
+      for (int tu = minU; tu <= maxU; ++tu) {
+        const int tile = tv*mNumTilesX + tu;
+        auto& buffer = buffers[tile];
+        if (buffer.capacity() < chunkSize) buffer.reserve(chunkSize);
+        buffer.push_back(x[i]);
+        buffer.push_back(y[i]);
+        buffer.push_back(z[i]);
+        if ((buffer.size() >= chunkSize) && !flush(tile)) return false;
+      }
+    }
+  }
+  for (int i = 0; i < numTiles; ++i) {
+    if (!flush(i)) return false;
+  }
+
+  // empty tiles have no file
+  for (int i = 0; i < numTiles; ++i) {
+    if (!created[i]) oFiles[i].clear();
+  }
+  return true;
+}
+
+bool TiledBlockFitter::
+fitTile(BlockFitter& ioFitter, const std::string& iFile,
+        std::vector<BlockFitter::Block>& oBlocks) const {
+  std::ifstream ifs(iFile, std::ios::binary | std::ios::ate);
+  if (!ifs.is_open()) return false;
+  const int n = ifs.tellg()/(3*sizeof(float));
+  ifs.seekg(0);
+
+  // the xyz triples are read in small chunks straight into the x, y and z
+  // arrays given to the fitter, the tile is never held twice
+  std::vector<float> coords(3*n);
+  std::vector<float> chunk(3*std::min(n, 65536));
+  for (int start = 0; start < n; ) {
+    const int count = std::min(n-start, (int)chunk.size()/3);
+    ifs.read((char*)chunk.data(), 3*count*sizeof(float));
+    if (!ifs.good()) return false;
+    for (int i = 0; i < count; ++i) {
+      coords[start+i] = chunk[3*i];
+      coords[n+start+i] = chunk[3*i+1];
+      coords[2*n+start+i] = chunk[3*i+2];
+    }
+    start += count;
+  }
+  ioFitter.setCloud(coords.data(), coords.data()+n, coords.data()+2*n, n);
+  auto result = ioFitter.go();
+  oBlocks = result.mBlocks;
+  return true;
+}
+
+std::vector<BlockFitter::Block> TiledBlockFitter::
+mergeBlocks(const std::vector<BlockFitter::Block>& iBlocks,
+            const std::vector<int>& iTiles) const {
+  const int n = iBlocks.size();
+  std::vector<Polygon> polygons(n);
+  std::vector<Eigen::Vector4f> planes(n);
+  std::vector<Eigen::Vector4f> bounds(n);
+  for (int i = 0; i < n; ++i) {
+    polygons[i] = projectHull(iBlocks[i]);
+    planes[i] = blockPlane(iBlocks[i]);
+    Eigen::Vector2f minPt(1e10, 1e10), maxPt(-1e10, -1e10);
+    for (const auto& p : polygons[i]) {
+      minPt = minPt.cwiseMin(p);
+      maxPt = maxPt.cwiseMax(p);
+    }
+    bounds[i] << minPt, maxPt;
+  }
+
+  // blocks bucketed by tile, only the blocks of neighbouring tiles are
+  // compared (a block fitted twice within one tile is left as it is)
+  std::vector<std::vector<int>> tileBlocks(mNumTilesX*mNumTilesY);
+  for (int i = 0; i < n; ++i) tileBlocks[iTiles[i]].push_back(i);
+  std::vector<std::pair<int,int>> candidates;
+  for (int tile = 0; tile < (int)tileBlocks.size(); ++tile) {
+    const int tu = tile%mNumTilesX;
+    const int tv = tile/mNumTilesX;
+    // each pair of neighbouring tiles is visited once
+    const int offsets[][2] = {{1,0}, {-1,1}, {0,1}, {1,1}};
+    for (const auto& offset : offsets) {
+      const int nu = tu + offset[0];
+      const int nv = tv + offset[1];
+      if ((nu < 0) || (nu >= mNumTilesX) || (nv >= mNumTilesY)) continue;
+      for (const int i : tileBlocks[tile]) {
+        for (const int j : tileBlocks[nv*mNumTilesX + nu]) {
+          candidates.emplace_back(i, j);
+        }
+      }
+    }
+  }
+
+  // group coplanar blocks whose hulls touch
+  std::vector<int> parents(n);
+  std::iota(parents.begin(), parents.end(), 0);
+  const float minCos = std::cos(mMaxMergeAngle);
+  for (const auto& candidate : candidates) {
+    const int i = candidate.first;
+    const int j = candidate.second;
+    if ((bounds[j][0] > bounds[i][2] + mMaxMergeGap) ||
+        (bounds[i][0] > bounds[j][2] + mMaxMergeGap) ||
+        (bounds[j][1] > bounds[i][3] + mMaxMergeGap) ||
+        (bounds[i][1] > bounds[j][3] + mMaxMergeGap)) continue;
+    if (planes[i].head<3>().dot(planes[j].head<3>()) < minCos) continue;
+    Eigen::Vector3f centerJ = Eigen::Vector3f::Zero();
+    for (const auto& p : iBlocks[j].mHull) centerJ += p;
+    centerJ /= iBlocks[j].mHull.size();
+    if (std::abs(planes[i].head<3>().dot(centerJ) + planes[i][3]) >
+        mMaxMergeOffset) continue;
+    if (polygonDistance(polygons[i], polygons[j]) > mMaxMergeGap) continue;
+    parents[findRoot(parents, j)] = findRoot(parents, i);
+  }
+
+  std::unordered_map<int,std::vector<int>> groups;
+  for (int i = 0; i < n; ++i) groups[findRoot(parents, i)].push_back(i);
+
+  std::vector<BlockFitter::Block> blocks;
+  for (const auto& it : groups) {
+    const auto& members = it.second;
+    if (members.size() == 1) {
+      blocks.push_back(iBlocks[members[0]]);
+      continue;
+    }
+
+    // the plane and orientation of the largest member are kept
+    int largest = members[0];
+    Polygon points;
+    for (const int idx : members) {
+      if (polygonArea(polygons[idx]) > polygonArea(polygons[largest])) {
+        largest = idx;
+      }
+      points.insert(points.end(), polygons[idx].begin(), polygons[idx].end());
+    }
+    const Eigen::Vector4f& plane = planes[largest];
+    BlockFitter::Block block = iBlocks[largest];
+    block.mHull.clear();
+    Eigen::Vector3f center = Eigen::Vector3f::Zero();
+    for (const auto& p : convexHull(points)) {
+      float z = -(plane[0]*p[0] + plane[1]*p[1] + plane[3])/plane[2];
+      block.mHull.push_back(Eigen::Vector3f(p[0], p[1], z));
+      center += block.mHull.back();
+    }
+    center /= block.mHull.size();
+
+    // the block keeps its offset below the plane
+    const Eigen::Matrix3f rotation = block.mPose.rotation();
+    const float depth = rotation.col(2).dot(iBlocks[largest].mPose.translation()) +
+      plane[3];
+    Eigen::Vector2f minPt(1e10, 1e10), maxPt(-1e10, -1e10);
+    for (const auto& p : block.mHull) {
+      Eigen::Vector2f q((p-center).dot(rotation.col(0)),
+                        (p-center).dot(rotation.col(1)));
+      minPt = minPt.cwiseMin(q);
+      maxPt = maxPt.cwiseMax(q);
+    }
+    block.mSize.head<2>() = maxPt-minPt;
+    block.mPose.translation() = center +
+      rotation.col(0)*(minPt[0]+maxPt[0])/2 +
+      rotation.col(1)*(minPt[1]+maxPt[1])/2 + rotation.col(2)*depth;
+    blocks.push_back(block);
+  }
+  return blocks;
+}
+
+BlockFitter::Result TiledBlockFitter::
+go(const MappedCloud& iCloud) {
+  BlockFitter::Result result;
+  result.mSuccess = false;
+  result.mGroundPlane.setZero();
+  auto t0 = std::chrono::high_resolution_clock::now();
+  if (!iCloud.isOpen() || (mTileSize <= 0)) return result;
+
+  const Eigen::Vector3f minPt = iCloud.getMinPoint();
+  const Eigen::Vector3f maxPt = iCloud.getMaxPoint();
+  mGridOrigin = minPt.head<2>();
+  mNumTilesX = std::max(1, (int)std::ceil((maxPt[0]-minPt[0])/mTileSize));
+  mNumTilesY = std::max(1, (int)std::ceil((maxPt[1]-minPt[1])/mTileSize));
+
+  std::string dirTemplate = mSpillDirectory + "/plane_seg_tiles_XXXXXX";
+  std::vector<char> dirName(dirTemplate.begin(), dirTemplate.end());
+  dirName.push_back('\0');
+  if (mkdtemp(dirName.data()) == NULL) {
+    std::cout << "TiledBlockFitter: cannot create a directory in " <<
+      mSpillDirectory << std::endl;
+    return result;
+  }
+  const std::string dir(dirName.data());
+
+  std::vector<std::string> files;
+  const bool spilled = spillTiles(iCloud, dir, files);
+  if (mDebug) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(t1-t0);
+    std::cout << "TiledBlockFitter: " << mNumTilesX << "x" << mNumTilesY <<
+      " tiles written in " << dt.count()/1e3 << " sec" << std::endl;
+  }
+
+  // one fitter per thread, the tiles are taken in turn
+  std::vector<std::vector<BlockFitter::Block>> tileBlocks(files.size());
+  std::atomic<size_t> nextTile(0);
+  std::atomic<bool> failed(!spilled);
+  auto worker = [&]() {
+    BlockFitter fitter(mFitter);
+    for (size_t i = nextTile++; i < files.size(); i = nextTile++) {
+      if (failed) break;
+      if (files[i].empty()) continue;
+      if (!fitTile(fitter, files[i], tileBlocks[i])) failed = true;
+      std::remove(files[i].c_str());
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < mNumThreads; ++i) threads.emplace_back(worker);
+  worker();
+  for (auto& thread : threads) thread.join();
+  for (const auto& file : files) {
+    if (!file.empty()) std::remove(file.c_str());
+  }
+  rmdir(dir.c_str());
+  if (failed) {
+    std::cout << "TiledBlockFitter: cannot read or write the tiles in " <<
+      dir << std::endl;
+    return result;
+  }
+
+  std::vector<BlockFitter::Block> blocks;
+  std::vector<int> tiles;
+  for (int i = 0; i < (int)tileBlocks.size(); ++i) {
+    blocks.insert(blocks.end(), tileBlocks[i].begin(), tileBlocks[i].end());
+    tiles.insert(tiles.end(), tileBlocks[i].size(), i);
+  }
+  result.mBlocks = mergeBlocks(blocks, tiles);
+  if (mDebug) {
+    std::cout << "TiledBlockFitter: " << blocks.size() << " tile blocks, " <<
+      result.mBlocks.size() << " after merging" << std::endl;
+  }
+
+  result.mTimings.mTotal = std::chrono::duration<float,std::milli>(
+    std::chrono::high_resolution_clock::now()-t0).count();
+  result.mSuccess = true;
+  return result;
+}
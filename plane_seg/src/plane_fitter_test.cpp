@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+#include "plane_seg/PlaneFitter.hpp"
+
+// Regression test of the prior normal mode on sets with only a few inliers,
+// whose local optimisation and final refit see fewer than 3 points.
+// Returns 0 when every fit succeeds with a finite plane close to the prior.
+
+namespace {
+
+planeseg::PlaneFitter makeGroundFitter() {
+  // same settings as the ground fit of BlockFitter
+  planeseg::PlaneFitter fitter;
+  fitter.setMaxDistance(0.01);
+  fitter.setRefineUsingInliers(true);
+  fitter.setLocalOptimization(true, 20);
+  fitter.setNormalPrior(Eigen::Vector3f::UnitZ(), 30*M_PI/180);
+  fitter.setPriorNormalSampling(true);
+  return fitter;
+}
+
+bool check(const planeseg::PlaneFitter::Result& iResult, const int iSeed,
+           const char* iName) {
+  const Eigen::Vector4f& plane = iResult.mPlane;
+  const bool ok = iResult.mSuccess && plane.allFinite() &&
+    (std::abs(plane[2]) > std::cos(30*M_PI/180));
+  if (!ok) {
+    std::cout << iName << ": bad fit with seed " << iSeed << ": " <<
+      plane.transpose() << std::endl;
+  }
+  return ok;
+}
+
+}
+
+int main() {
+  const planeseg::PlaneFitter fitter = makeGroundFitter();
+  int numFailed = 0;
+
+  for (int seed = 0; seed < 50; ++seed) {
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float> uniform(-1, 1);
+
+    // 2 to 5 points on a plane, the others far from it and from each other
+    for (int numInliers = 2; numInliers <= 5; ++numInliers) {
+      std::vector<Eigen::Vector3f> pts;
+      for (int i = 0; i < numInliers; ++i) {
+        pts.emplace_back(uniform(engine), uniform(engine), 0);
+      }
+      for (int i = 0; i < 10; ++i) {
+        pts.emplace_back(uniform(engine), uniform(engine), 0.5f*(i+1));
+      }
+      std::shuffle(pts.begin(), pts.end(), engine);
+      if (!check(fitter.go(pts), seed, "few inliers")) ++numFailed;
+    }
+
+    // ground grid with clutter
+    std::vector<Eigen::Vector3f> pts;
+    for (int i = 0; i < 30; ++i) {
+      for (int j = 0; j < 30; ++j) {
+        pts.emplace_back(0.1f*i, 0.1f*j, 0);
+      }
+    }
+    for (int i = 0; i < 60; ++i) {
+      pts.emplace_back(3*uniform(engine), 3*uniform(engine), 1+uniform(engine));
+    }
+    std::shuffle(pts.begin(), pts.end(), engine);
+    if (!check(fitter.go(pts), seed, "ground grid")) ++numFailed;
+  }
+
+  std::cout << numFailed << " failed" << std::endl;
+  return (numFailed == 0) ? 0 : 1;
+}
@@ -0,0 +1,284 @@
+// Offline batch processing of PCD/PLY (or binary .psc) clouds: each worker
+// thread owns a BlockFitter and the results are appended to a JSON Lines
+// file, one line per cloud.
+//
+// usage: plane_seg_batch <directory | list file> <output.jsonl> [options]
+//
+// A list file has one cloud per line, optionally followed by the sensor pose:
+//   path [origin_x origin_y origin_z look_x look_y look_z]
+// Relative paths are relative to the list file. The clouds of a directory
+// (and the list entries without a pose) use the default pose, or the pose
+// stored in the file for binary clouds.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/io/ply_io.h>
+
+#include "plane_seg/BlockFitter.hpp"
+#include "plane_seg/MappedCloud.hpp"
+
+namespace fs = boost::filesystem;
+
+struct Job {
+  std::string mFile;
+  Eigen::Vector3f mOrigin;
+  Eigen::Vector3f mLookDir;
+  bool mHasPose;
+};
+
+struct Options {
+  int mNumThreads;
+  bool mRemoveGround;
+  float mDownsampleResolution;
+  float mMaxAngleOfPlaneSegmenter;
+  Eigen::Vector3f mOrigin;
+  Eigen::Vector3f mLookDir;
+
+  Options() {
+    mNumThreads = std::max(1u, std::thread::hardware_concurrency());
+    // same settings as plane_seg_ros
+    mRemoveGround = false;
+    mDownsampleResolution = 0.01;
+    mMaxAngleOfPlaneSegmenter = 10;
+    mOrigin = Eigen::Vector3f::Zero();
+    mLookDir = Eigen::Vector3f::UnitX();
+  }
+};
+
+bool isCloudFile(const fs::path& iPath) {
+  std::string ext = iPath.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return (ext == ".pcd") || (ext == ".ply") || (ext == ".psc");
+}
+
+bool collectJobs(const std::string& iInput, const Options& iOptions,
+                 std::vector<Job>& oJobs) {
+  fs::path input(iInput);
+  if (fs::is_directory(input)) {
+    std::vector<fs::path> files;
+    for (fs::directory_iterator it(input); it != fs::directory_iterator(); ++it) {
+      if (fs::is_regular_file(it->path()) && isCloudFile(it->path())) {
+        files.push_back(it->path());
+      }
+    }
+    std::sort(files.begin(), files.end());
+    for (const auto& file : files) {
+      oJobs.push_back({file.string(), iOptions.mOrigin, iOptions.mLookDir, false});
+    }
+    return true;
+  }
+
+  std::ifstream ifs(iInput);
+  if (!ifs.is_open()) {
+    std::cout << "error: cannot open " << iInput << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(ifs, line)) {
+    std::istringstream iss(line);
+    std::string name;
+    if (!(iss >> name) || (name[0] == '#')) continue;
+    Job job{name, iOptions.mOrigin, iOptions.mLookDir, false};
+    Eigen::Vector3f origin, lookDir;
+    if (iss >> origin[0] >> origin[1] >> origin[2] >>
+        lookDir[0] >> lookDir[1] >> lookDir[2]) {
+      job.mOrigin = origin;
+      job.mLookDir = lookDir;
+      job.mHasPose = true;
+    }
+    fs::path path(name);
+    if (path.is_relative()) job.mFile = (input.parent_path() / path).string();
+    oJobs.push_back(job);
+  }
+  return true;
+}
+
+bool isMappedCloudFile(const std::string& iFile) {
+  std::string ext = fs::path(iFile).extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return ext == ".psc";
+}
+
+bool loadCloud(const std::string& iFile, planeseg::LabeledCloud& oCloud) {
+  std::string ext = fs::path(iFile).extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  if (ext == ".ply") return pcl::io::loadPLYFile(iFile, oCloud) >= 0;
+  return pcl::io::loadPCDFile(iFile, oCloud) >= 0;
+}
+
+std::string escapeJson(const std::string& iString) {
+  std::string out;
+  for (const char c : iString) {
+    switch (c) {
+    case '"': out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\b': out += "\\b"; break;
+    case '\f': out += "\\f"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    default:
+      if ((unsigned char)c < 0x20) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+        out += buf;
+      }
+      else out += c;
+    }
+  }
+  return out;
+}
+
+// JSON has no nan or inf, they are written as null
+std::string numToJson(const double iVal) {
+  if (!std::isfinite(iVal)) return "null";
+  std::ostringstream oss;
+  oss << iVal;
+  return oss.str();
+}
+
+std::string vecToJson(const Eigen::Vector3f& iVec) {
+  return "[" + numToJson(iVec[0]) + ", " + numToJson(iVec[1]) + ", " +
+    numToJson(iVec[2]) + "]";
+}
+
+std::string resultToJson(const Job& iJob, const int iNumPoints,
+                         const planeseg::BlockFitter::Result& iResult) {
+  const auto& t = iResult.mTimings;
+  std::ostringstream oss;
+  oss << "{\"file\": \"" << escapeJson(iJob.mFile) << "\"";
+  oss << ", \"origin\": " << vecToJson(iJob.mOrigin);
+  oss << ", \"look_dir\": " << vecToJson(iJob.mLookDir);
+  oss << ", \"points\": " << iNumPoints;
+  oss << ", \"success\": " << (iResult.mSuccess ? "true" : "false");
+  oss << ", \"timings_ms\": {\"voxelize\": " << numToJson(t.mVoxelize) <<
+    ", \"ground_removal\": " << numToJson(t.mGroundRemoval) <<
+    ", \"normals\": " << numToJson(t.mNormals) <<
+    ", \"segmentation\": " << numToJson(t.mSegmentation) <<
+    ", \"rectangles\": " << numToJson(t.mRectangles) <<
+    ", \"total\": " << numToJson(t.mTotal) << "}";
+  oss << ", \"blocks\": [";
+  for (int i = 0; i < (int)iResult.mBlocks.size(); ++i) {
+    const auto& block = iResult.mBlocks[i];
+    Eigen::Quaternionf q(block.mPose.rotation());
+    oss << (i > 0 ? ", " : "") << "{\"size\": " << vecToJson(block.mSize) <<
+      ", \"position\": " << vecToJson(block.mPose.translation()) <<
+      ", \"quaternion\": [" << numToJson(q.w()) << ", " << numToJson(q.x()) <<
+      ", " << numToJson(q.y()) << ", " << numToJson(q.z()) << "], \"hull\": [";
+    for (int j = 0; j < (int)block.mHull.size(); ++j) {
+      oss << (j > 0 ? ", " : "") << vecToJson(block.mHull[j]);
+    }
+    oss << "]}";
+  }
+  oss << "]}";
+  return oss.str();
+}
+
+int main(const int iArgc, const char** iArgv) {
+  Options options;
+  std::vector<std::string> positional;
+  for (int i = 1; i < iArgc; ++i) {
+    std::string arg(iArgv[i]);
+    if ((arg == "-j") && (i+1 < iArgc)) {
+      options.mNumThreads = std::max(1, std::atoi(iArgv[++i]));
+    }
+    else if (arg == "--remove-ground") {
+      options.mRemoveGround = true;
+    }
+    else if ((arg == "--resolution") && (i+1 < iArgc)) {
+      options.mDownsampleResolution = std::atof(iArgv[++i]);
+    }
+    else if ((arg == "--segmenter-angle") && (i+1 < iArgc)) {
+      options.mMaxAngleOfPlaneSegmenter = std::atof(iArgv[++i]);
+    }
+    else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() != 2) {
+    std::cout << "usage: plane_seg_batch <directory | list file> <output.jsonl>"
+      " [-j threads] [--remove-ground] [--resolution meters]"
+      " [--segmenter-angle degrees]" << std::endl;
+    return -1;
+  }
+
+  std::vector<Job> jobs;
+  if (!collectJobs(positional[0], options, jobs)) return -1;
+  std::ofstream ofs(positional[1]);
+  if (!ofs.is_open()) {
+    std::cout << "error: cannot write " << positional[1] << std::endl;
+    return -1;
+  }
+  std::cout << "processing " << jobs.size() << " clouds with " <<
+    options.mNumThreads << " threads" << std::endl;
+
+  auto t0 = std::chrono::high_resolution_clock::now();
+  std::atomic<size_t> nextJob(0);
+  std::atomic<int> numFailed(0);
+  std::mutex outputMutex;
+  auto worker = [&]() {
+    planeseg::BlockFitter fitter;
+    fitter.setDebug(false);  // the debug files would be written by all workers
+    fitter.setRemoveGround(options.mRemoveGround);
+    fitter.setDownsampleResolution(options.mDownsampleResolution);
+    fitter.setMaxAngleOfPlaneSegmenter(options.mMaxAngleOfPlaneSegmenter);
+    for (size_t i = nextJob++; i < jobs.size(); i = nextJob++) {
+      Job job = jobs[i];
+      planeseg::LabeledCloud::Ptr cloud(new planeseg::LabeledCloud());
+      planeseg::MappedCloud mapped;
+      int numPoints = 0;
+      bool loaded;
+      if (isMappedCloudFile(job.mFile)) {
+        loaded = mapped.open(job.mFile);
+        if (loaded) {
+          fitter.setCloud(mapped.x(), mapped.y(), mapped.z(), mapped.size());
+          numPoints = mapped.size();
+          if (!job.mHasPose) {
+            job.mOrigin = mapped.getOrigin();
+            job.mLookDir = mapped.getLookDir();
+          }
+        }
+      }
+      else {
+        loaded = loadCloud(job.mFile, *cloud);
+        fitter.setCloud(cloud);
+        numPoints = cloud->size();
+      }
+      if (!loaded) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cout << "error: cannot read " << job.mFile << std::endl;
+        ++numFailed;
+        continue;
+      }
+      fitter.setSensorPose(job.mOrigin, job.mLookDir);
+      auto result = fitter.go();
+      std::string line = resultToJson(job, numPoints, result);
+
+      std::lock_guard<std::mutex> lock(outputMutex);
+      ofs << line << "\n";
+      if (!result.mSuccess) ++numFailed;
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < options.mNumThreads; ++i) threads.emplace_back(worker);
+  worker();
+  for (auto& thread : threads) thread.join();
+
+  auto t1 = std::chrono::high_resolution_clock::now();
+  auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(t1-t0);
+  std::cout << "finished in " << dt.count()/1e3 << " sec, " << numFailed <<
+    " failed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,52 @@
+// Converts a PCD/PLY cloud into the binary cloud format read by MappedCloud.
+//
+// usage: plane_seg_convert <input.pcd|ply> <output.psc>
+//                          [origin_x origin_y origin_z look_x look_y look_z]
+
+#include <iostream>
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/io/ply_io.h>
+
+#include "plane_seg/MappedCloud.hpp"
+
+int main(const int iArgc, const char** iArgv) {
+  if ((iArgc != 3) && (iArgc != 9)) {
+    std::cout << "usage: plane_seg_convert <input.pcd|ply> <output.psc>"
+      " [origin_x origin_y origin_z look_x look_y look_z]" << std::endl;
+    return -1;
+  }
+  std::string inFile(iArgv[1]);
+  std::string outFile(iArgv[2]);
+  Eigen::Vector3f origin(0,0,0), lookDir(1,0,0);
+  if (iArgc == 9) {
+    for (int k = 0; k < 3; ++k) {
+      origin[k] = std::atof(iArgv[3+k]);
+      lookDir[k] = std::atof(iArgv[6+k]);
+    }
+  }
+
+  planeseg::LabeledCloud cloud;
+  int status;
+  if (inFile.find(".ply") != std::string::npos) {
+    status = pcl::io::loadPLYFile(inFile, cloud);
+  }
+  else {
+    status = pcl::io::loadPCDFile(inFile, cloud);
+  }
+  if (status < 0) {
+    std::cout << "error: cannot read " << inFile << std::endl;
+    return -1;
+  }
+  if (!planeseg::writeCloudFile(outFile, cloud, origin, lookDir)) {
+    std::cout << "error: cannot write " << outFile << std::endl;
+    return -1;
+  }
+
+  planeseg::MappedCloud mapped;
+  if (!mapped.open(outFile)) return -1;
+  std::cout << "wrote " << mapped.size() << " points to " << outFile <<
+    ", bounds [" << mapped.getMinPoint().transpose() << "] - [" <<
+    mapped.getMaxPoint().transpose() << "]" << std::endl;
+  return 0;
+}
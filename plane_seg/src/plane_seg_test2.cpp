@@ -71,6 +71,7 @@ int main() {
   est.setMaxCenterError(0.05);
   est.setMaxIterations(200);
   est.computeCurvature(true);
+  est.setOrderedSampling(true);
   est.go(inCloud, *normals);
 
   // grab normal at click point
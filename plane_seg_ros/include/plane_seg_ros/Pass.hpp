@@ -0,0 +1,121 @@
+#ifndef _plane_seg_ros_Pass_hpp_
+#define _plane_seg_ros_Pass_hpp_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <ros/ros.h>
+
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <grid_map_msgs/GridMap.h>
+#include <grid_map_core/grid_map_core.hpp>
+
+#include "plane_seg_ros/SegmentRegion.h"
+#include "plane_seg_ros/PlaneArray.h"
+
+#include "plane_seg/BlockFitter.hpp"
+#include "plane_seg/MappedCloud.hpp"
+#include "plane_seg/TiledBlockFitter.hpp"
+#include "plane_seg/ScanAccumulator.hpp"
+#include "plane_seg/PlaneTracker.hpp"
+
+
+class Pass{
+  public:
+    // subscribe_to_map is false when the elevation maps are decoded by the owner of
+    // the object and passed to processGridMap(). One object per input source, each
+    // with its own output_ns, keeps the sources from sharing results and ids.
+    Pass(ros::NodeHandle node_, bool subscribe_to_map = true, bool subscribe_to_cloud = true,
+         const std::string& output_ns = "/plane_seg");
+    
+    ~Pass(){
+      stopWorker();
+    }
+
+    // processes the received messages on a thread of its own instead of in the
+    // callbacks, keeping only the latest message of each source while it is busy
+    void startWorker();
+    void stopWorker();
+
+    void elevationMapCallback(const grid_map_msgs::GridMap::ConstPtr& msg);
+    void pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr &msg);
+    void robotPoseCallBack(const geometry_msgs::PoseWithCovarianceStampedConstPtr &msg);
+    bool segmentRegionCallback(plane_seg_ros::SegmentRegion::Request& req,
+                               plane_seg_ros::SegmentRegion::Response& res);
+
+    void processGridMap(const grid_map::GridMap& map);
+    // without downsampling the blocks keep the labels of their input points
+    void processCloud(planeseg::LabeledCloud::Ptr& inCloud, Eigen::Vector3f origin, Eigen::Vector3f lookDir,
+                      bool downsample = true);
+    void processMappedCloud(const planeseg::MappedCloud& inCloud, Eigen::Vector3f origin, Eigen::Vector3f lookDir);
+    // reads the cached binary copy of the example when there is one, and writes it otherwise
+    void processFromFile(int test_example);
+
+    void publishHullsAsCloud(std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> cloud_ptrs,
+                                 int secs, int nsecs);
+
+    void publishHullsAsMarkers(std::vector< pcl::PointCloud<pcl::PointXYZ>::Ptr > cloud_ptrs,
+                                 int secs, int nsecs);
+    void printResultAsJson();
+    void publishResult();
+    void publishPlanes();
+    void publishPlaneMap(const grid_map::GridMap& map);
+
+    const planeseg::BlockFitter::Result& getResult() const { return result_; }
+
+  private:
+    void handleElevationMap(const grid_map_msgs::GridMap::ConstPtr& msg);
+    void handlePointCloud(const sensor_msgs::PointCloud2::ConstPtr& msg);
+    void workerLoop();
+    Eigen::Isometry3d getRobotPose();
+    void configureFitter(planeseg::BlockFitter& fitter, Eigen::Vector3f origin, Eigen::Vector3f lookDir);
+    void publishLookPose(Eigen::Vector3f origin, Eigen::Vector3f lookDir);
+    // latest cloud, for the segment_region service
+    void cacheCloud(const planeseg::LabeledCloud::Ptr& inCloud, Eigen::Vector3f origin, Eigen::Vector3f lookDir);
+
+    ros::NodeHandle node_;
+    std::vector<double> colors_;
+
+    ros::Subscriber point_cloud_sub_, grid_map_sub_, pose_sub_;
+    ros::Publisher received_cloud_pub_, hull_cloud_pub_, hull_markers_pub_, look_pose_pub_, planes_pub_,
+                   plane_map_pub_;
+    ros::ServiceServer segment_region_srv_;
+
+    std::mutex pose_mutex_;
+    Eigen::Isometry3d last_robot_pose_;
+    bool publish_received_cloud_;
+    double tile_size_;
+    bool cache_normals_;
+    std::string normals_cache_dir_;
+    bool accumulate_;
+    planeseg::ScanAccumulator accumulator_;
+    bool continuous_processing_;
+
+    planeseg::PlaneTracker plane_tracker_;
+    bool publish_delta_;
+    int delta_keyframe_interval_;
+    int planes_msg_count_;
+    // planes of result_, in the order of its blocks
+    std::vector<planeseg::PlaneTracker::Plane> planes_;
+    bool publish_plane_map_;
+    bool publish_markers_;
+    double marker_rate_;
+    ros::Time last_marker_time_;
+
+    std::mutex latest_cloud_mutex_;
+    planeseg::LabeledCloud::Ptr latest_cloud_;
+    Eigen::Vector3f latest_origin_, latest_look_dir_;
+    planeseg::BlockFitter::Result result_;
+
+    std::thread worker_;
+    std::mutex worker_mutex_;
+    std::condition_variable worker_cv_;
+    bool worker_running_;
+    grid_map_msgs::GridMap::ConstPtr pending_map_;
+    sensor_msgs::PointCloud2::ConstPtr pending_cloud_;
+};
+
+#endif
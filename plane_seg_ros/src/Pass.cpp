@@ -0,0 +1,822 @@
+#include <cmath>
+#include <limits>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <ros/ros.h>
+#include <ros/console.h>
+#include <ros/package.h>
+
+
+#include <eigen_conversions/eigen_msg.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/io/ply_io.h>
+
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
+#include <visualization_msgs/Marker.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <grid_map_msgs/GridMap.h>
+#include <grid_map_ros/grid_map_ros.hpp>
+#include <grid_map_ros/GridMapRosConverter.hpp>
+
+#include "plane_seg_ros/Pass.hpp"
+#include "plane_seg/Geometry.hpp"
+
+
+// convenience methods
+auto vecToStr = [](const Eigen::Vector3f& iVec) {
+  std::ostringstream oss;
+  oss << iVec[0] << ", " << iVec[1] << ", " << iVec[2];
+  return oss.str();
+};
+auto rotToStr = [](const Eigen::Matrix3f& iRot) {
+  std::ostringstream oss;
+  Eigen::Quaternionf q(iRot);
+  oss << q.w() << ", " << q.x() << ", " << q.y() << ", " << q.z();
+  return oss.str();
+};
+// a cached copy is only used if it was written after the last change of its source
+auto isCacheFresh = [](const std::string& iCacheFile, const std::string& iSourceFile) {
+  struct stat cacheInfo, sourceInfo;
+  if (stat(iCacheFile.c_str(), &cacheInfo) != 0) return false;
+  if (stat(iSourceFile.c_str(), &sourceInfo) != 0) return true;
+  return cacheInfo.st_mtime >= sourceInfo.st_mtime;
+};
+
+
+Pass::Pass(ros::NodeHandle node_, bool subscribe_to_map, bool subscribe_to_cloud,
+           const std::string& output_ns):
+    node_(node_), worker_running_(false){
+
+  std::string input_body_pose_topic;
+  node_.getParam("input_body_pose_topic", input_body_pose_topic);
+  node_.param("publish_received_cloud", publish_received_cloud_, true);
+  // tiling of the binary clouds read by processFromFile, disabled when 0
+  node_.param("tile_size", tile_size_, 0.0);
+  // normals of the files read by processFromFile are stored next to them
+  node_.param("cache_normals", cache_normals_, false);
+  // when false the clouds are only kept for the segment_region service
+  node_.param("continuous_processing", continuous_processing_, true);
+
+  // planes with persistent ids on /plane_seg/planes, only the changes in delta mode
+  node_.param("publish_delta", publish_delta_, false);
+  node_.param("delta_keyframe_interval", delta_keyframe_interval_, 10);
+  planes_msg_count_ = 0;
+  // hull cloud and markers, at most marker_rate Hz (no limit when 0)
+  node_.param("publish_markers", publish_markers_, true);
+  node_.param("marker_rate", marker_rate_, 0.0);
+  // elevation map with the plane_id, plane_normal_z and plane_offset layers
+  node_.param("publish_plane_map", publish_plane_map_, false);
+
+  // sparse scans are fused over a sliding window before the fitting, disabled when 1
+  int accumulate_scans;
+  double accumulate_seconds, accumulate_resolution;
+  node_.param("accumulate_scans", accumulate_scans, 1);
+  node_.param("accumulate_seconds", accumulate_seconds, 0.0);
+  node_.param("accumulate_resolution", accumulate_resolution, 0.01);
+  accumulate_ = (accumulate_scans > 1) || (accumulate_seconds > 0);
+  accumulator_.setMaxScans(accumulate_scans > 1 ? accumulate_scans : 1000);
+  accumulator_.setMaxAge(accumulate_seconds);
+  accumulator_.setResolution(accumulate_resolution);
+
+  if (subscribe_to_map){
+    grid_map_sub_ = node_.subscribe("/elevation_mapping/elevation_map", 100,
+                                      &Pass::elevationMapCallback, this);
+  }
+  if (subscribe_to_cloud){
+    point_cloud_sub_ = node_.subscribe("/plane_seg/point_cloud_in", 100,
+                                      &Pass::pointCloudCallback, this);
+  }
+  pose_sub_ = node_.subscribe("/state_estimator/pose_in_odom", 100,
+                                    &Pass::robotPoseCallBack, this);
+
+  received_cloud_pub_ = node_.advertise<sensor_msgs::PointCloud2>(output_ns + "/received_cloud", 10);
+  hull_cloud_pub_ = node_.advertise<sensor_msgs::PointCloud2>(output_ns + "/hull_cloud", 10);
+  hull_markers_pub_ = node_.advertise<visualization_msgs::Marker>(output_ns + "/hull_markers", 10);
+  look_pose_pub_ = node_.advertise<geometry_msgs::PoseStamped>(output_ns + "/look_pose", 10);
+  planes_pub_ = node_.advertise<plane_seg_ros::PlaneArray>(output_ns + "/planes", 10);
+  plane_map_pub_ = node_.advertise<grid_map_msgs::GridMap>(output_ns + "/plane_map", 1);
+  segment_region_srv_ = node_.advertiseService(output_ns + "/segment_region",
+                                    &Pass::segmentRegionCallback, this);
+
+  last_robot_pose_ = Eigen::Isometry3d::Identity();
+
+  colors_ = {
+       51/255.0, 160/255.0, 44/255.0,  //0
+       166/255.0, 206/255.0, 227/255.0,
+       178/255.0, 223/255.0, 138/255.0,//6
+       31/255.0, 120/255.0, 180/255.0,
+       251/255.0, 154/255.0, 153/255.0,// 12
+       227/255.0, 26/255.0, 28/255.0,
+       253/255.0, 191/255.0, 111/255.0,// 18
+       106/255.0, 61/255.0, 154/255.0,
+       255/255.0, 127/255.0, 0/255.0, // 24
+       202/255.0, 178/255.0, 214/255.0,
+       1.0, 0.0, 0.0, // red // 30
+       0.0, 1.0, 0.0, // green
+       0.0, 0.0, 1.0, // blue// 36
+       1.0, 1.0, 0.0,
+       1.0, 0.0, 1.0, // 42
+       0.0, 1.0, 1.0,
+       0.5, 1.0, 0.0,
+       1.0, 0.5, 0.0,
+       0.5, 0.0, 1.0,
+       1.0, 0.0, 0.5,
+       0.0, 0.5, 1.0,
+       0.0, 1.0, 0.5,
+       1.0, 0.5, 0.5,
+       0.5, 1.0, 0.5,
+       0.5, 0.5, 1.0,
+       0.5, 0.5, 1.0,
+       0.5, 1.0, 0.5,
+       0.5, 0.5, 1.0};
+
+}
+
+void Pass::robotPoseCallBack(const geometry_msgs::PoseWithCovarianceStampedConstPtr &msg){
+  //std::cout << "got pose\n";
+  Eigen::Isometry3d pose;
+  tf::poseMsgToEigen(msg->pose.pose, pose);
+  std::lock_guard<std::mutex> lock(pose_mutex_);
+  last_robot_pose_ = pose;
+}
+
+
+Eigen::Isometry3d Pass::getRobotPose(){
+  std::lock_guard<std::mutex> lock(pose_mutex_);
+  return last_robot_pose_;
+}
+
+
+void Pass::startWorker(){
+  std::lock_guard<std::mutex> lock(worker_mutex_);
+  if (worker_running_){
+    return;
+  }
+  worker_running_ = true;
+  worker_ = std::thread(&Pass::workerLoop, this);
+}
+
+
+void Pass::stopWorker(){
+  {
+    std::lock_guard<std::mutex> lock(worker_mutex_);
+    worker_running_ = false;
+  }
+  worker_cv_.notify_all();
+  if (worker_.joinable()){
+    worker_.join();
+  }
+}
+
+
+void Pass::workerLoop(){
+  while (true){
+    grid_map_msgs::GridMap::ConstPtr map_msg;
+    sensor_msgs::PointCloud2::ConstPtr cloud_msg;
+    {
+      std::unique_lock<std::mutex> lock(worker_mutex_);
+      worker_cv_.wait(lock, [this]{ return !worker_running_ || pending_map_ || pending_cloud_; });
+      if (!worker_running_){
+        return;
+      }
+      map_msg.swap(pending_map_);
+      cloud_msg.swap(pending_cloud_);
+    }
+    if (map_msg){
+      handleElevationMap(map_msg);
+    }
+    if (cloud_msg){
+      handlePointCloud(cloud_msg);
+    }
+  }
+}
+
+
+void quat_to_euler(const Eigen::Quaterniond& q, double& roll, double& pitch, double& yaw) {
+  const double q0 = q.w();
+  const double q1 = q.x();
+  const double q2 = q.y();
+  const double q3 = q.z();
+  roll = atan2(2.0*(q0*q1+q2*q3), 1.0-2.0*(q1*q1+q2*q2));
+  pitch = asin(2.0*(q0*q2-q3*q1));
+  yaw = atan2(2.0*(q0*q3+q1*q2), 1.0-2.0*(q2*q2+q3*q3));
+}
+
+Eigen::Vector3f convertRobotPoseToSensorLookDir(Eigen::Isometry3d robot_pose){
+
+  Eigen::Quaterniond quat = Eigen::Quaterniond( robot_pose.rotation() );
+  double r,p,y;
+  quat_to_euler(quat, r, p, y);
+  //std::cout << r*180/M_PI << ", " << p*180/M_PI << ", " << y*180/M_PI << " rpy in Degrees\n";
+
+  double yaw = y;
+  double pitch = -p;
+  double xDir = cos(yaw)*cos(pitch);
+  double yDir = sin(yaw)*cos(pitch);
+  double zDir = sin(pitch);
+  return Eigen::Vector3f(xDir, yDir, zDir);
+}
+
+
+void Pass::elevationMapCallback(const grid_map_msgs::GridMap::ConstPtr& msg){
+  //std::cout << "got grid map / ev map\n";
+  {
+    std::lock_guard<std::mutex> lock(worker_mutex_);
+    if (worker_running_){
+      // a map still waiting for the worker is superseded by this one
+      pending_map_ = msg;
+      worker_cv_.notify_one();
+      return;
+    }
+  }
+  handleElevationMap(msg);
+}
+
+
+void Pass::handleElevationMap(const grid_map_msgs::GridMap::ConstPtr& msg){
+
+  // convert message to GridMap, to PointCloud to LabeledCloud
+  grid_map::GridMap map;
+  grid_map::GridMapRosConverter::fromMessage(*msg, map);
+  processGridMap(map);
+}
+
+
+void Pass::processGridMap(const grid_map::GridMap& map){
+  // one point per valid cell, labelled with the linear index of the cell
+  planeseg::LabeledCloud::Ptr inCloud(new planeseg::LabeledCloud());
+  const grid_map::Matrix& elevation = map["elevation"];
+  for (grid_map::GridMapIterator it(map); !it.isPastEnd(); ++it){
+    const grid_map::Index index(*it);
+    const float z = elevation(index(0), index(1));
+    if (!std::isfinite(z)){
+      continue;
+    }
+    grid_map::Position position;
+    map.getPosition(index, position);
+    planeseg::Point point;
+    point.x = position.x();
+    point.y = position.y();
+    point.z = z;
+    point.label = it.getLinearIndex();
+    inCloud->push_back(point);
+  }
+
+  const Eigen::Isometry3d robot_pose = getRobotPose();
+  Eigen::Vector3f origin, lookDir;
+  origin << robot_pose.translation().cast<float>();
+  lookDir = convertRobotPoseToSensorLookDir(robot_pose);
+
+  cacheCloud(inCloud, origin, lookDir);
+  if (continuous_processing_){
+    // the cells are fitted without downsampling so that the blocks keep their labels
+    processCloud(inCloud, origin, lookDir, !publish_plane_map_);
+    if (publish_plane_map_){
+      publishPlaneMap(map);
+    }
+  }
+}
+
+
+// the segments written back into the cells they were fitted to
+void Pass::publishPlaneMap(const grid_map::GridMap& map){
+  grid_map::GridMap plane_map(map);
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  plane_map.add("plane_id", nan);
+  plane_map.add("plane_normal_z", nan);
+  plane_map.add("plane_offset", nan);
+  grid_map::Matrix& ids = plane_map["plane_id"];
+  grid_map::Matrix& normals_z = plane_map["plane_normal_z"];
+  grid_map::Matrix& offsets = plane_map["plane_offset"];
+
+  for (size_t i = 0; (i < result_.mBlocks.size()) && (i < planes_.size()); ++i){
+    const auto& plane = planes_[i];
+    for (const uint32_t label : result_.mBlocks[i].mInputLabels){
+      const grid_map::Index index = grid_map::getIndexFromLinearIndex(label, plane_map.getSize());
+      ids(index(0), index(1)) = plane.mId;
+      normals_z(index(0), index(1)) = plane.mPlane[2];
+      offsets(index(0), index(1)) = plane.mPlane[3];
+    }
+  }
+
+  grid_map_msgs::GridMap msg;
+  grid_map::GridMapRosConverter::toMessage(plane_map, msg);
+  plane_map_pub_.publish(msg);
+}
+
+
+void Pass::cacheCloud(const planeseg::LabeledCloud::Ptr& inCloud, Eigen::Vector3f origin, Eigen::Vector3f lookDir){
+  std::lock_guard<std::mutex> lock(latest_cloud_mutex_);
+  latest_cloud_ = inCloud;
+  latest_origin_ = origin;
+  latest_look_dir_ = lookDir;
+}
+
+
+// process a point cloud 
+// This method is mostly for testing
+// To transmit a static point cloud:
+// rosrun pcl_ros pcd_to_pointcloud 06.pcd   _frame_id:=/odom /cloud_pcd:=/plane_seg/point_cloud_in
+void Pass::pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr &msg){
+  {
+    std::lock_guard<std::mutex> lock(worker_mutex_);
+    if (worker_running_){
+      pending_cloud_ = msg;
+      worker_cv_.notify_one();
+      return;
+    }
+  }
+  handlePointCloud(msg);
+}
+
+
+void Pass::handlePointCloud(const sensor_msgs::PointCloud2::ConstPtr& msg){
+  planeseg::LabeledCloud::Ptr inCloud(new planeseg::LabeledCloud());
+  pcl::fromROSMsg(*msg,*inCloud);
+
+  // the clouds are in the odometry frame, they are fused as they are
+  if (accumulate_){
+    accumulator_.addScan(*inCloud, msg->header.stamp.toSec());
+    accumulator_.getCloud(*inCloud);
+  }
+
+  const Eigen::Isometry3d robot_pose = getRobotPose();
+  Eigen::Vector3f origin, lookDir;
+  origin << robot_pose.translation().cast<float>();
+  lookDir = convertRobotPoseToSensorLookDir(robot_pose);
+
+  cacheCloud(inCloud, origin, lookDir);
+  if (continuous_processing_){
+    processCloud(inCloud, origin, lookDir);
+  }
+}
+
+
+// fits the blocks of a region of the latest cloud, on demand
+bool Pass::segmentRegionCallback(plane_seg_ros::SegmentRegion::Request& req,
+                                 plane_seg_ros::SegmentRegion::Response& res){
+  planeseg::LabeledCloud::Ptr cloud;
+  Eigen::Vector3f origin, lookDir;
+  {
+    std::lock_guard<std::mutex> lock(latest_cloud_mutex_);
+    cloud = latest_cloud_;
+    origin = latest_origin_;
+    lookDir = latest_look_dir_;
+  }
+  res.success = false;
+  res.timed_out = false;
+  res.num_points = 0;
+  if (!cloud){
+    ROS_WARN_STREAM("segment_region: no cloud received yet");
+    return true;
+  }
+
+  Eigen::Vector3f minPt(req.min_point.x, req.min_point.y, req.min_point.z);
+  Eigen::Vector3f maxPt(req.max_point.x, req.max_point.y, req.max_point.z);
+  bool useBox = (minPt != maxPt);
+  std::vector<Eigen::Vector2f> polygon;
+  for (const auto& p : req.polygon){
+    polygon.push_back(Eigen::Vector2f(p.x, p.y));
+  }
+
+  planeseg::LabeledCloud::Ptr roiCloud(new planeseg::LabeledCloud());
+  for (const auto& pt : cloud->points){
+    const Eigen::Vector3f p = pt.getVector3fMap();
+    if (useBox && ((p.array() < minPt.array()).any() || (p.array() > maxPt.array()).any())){
+      continue;
+    }
+    if ((polygon.size() >= 3) && !planeseg::isInsidePolygon(polygon, p.head<2>())){
+      continue;
+    }
+    roiCloud->push_back(pt);
+  }
+  res.num_points = roiCloud->size();
+
+  planeseg::BlockFitter fitter;
+  configureFitter(fitter, origin, lookDir);
+  fitter.setCloud(roiCloud);
+  fitter.setTimeBudget(req.timeout.toSec()*1e3);
+  planeseg::BlockFitter::Result result = fitter.go();
+
+  res.success = result.mSuccess;
+  res.timed_out = result.mTimedOut;
+  for (const auto& block : result.mBlocks){
+    geometry_msgs::Pose pose;
+    tf::poseEigenToMsg(block.mPose.cast<double>(), pose);
+    res.poses.push_back(pose);
+    geometry_msgs::Vector3 size;
+    size.x = block.mSize[0];
+    size.y = block.mSize[1];
+    size.z = block.mSize[2];
+    res.sizes.push_back(size);
+    geometry_msgs::Polygon hull;
+    for (const auto& p : block.mHull){
+      geometry_msgs::Point32 point;
+      point.x = p[0];
+      point.y = p[1];
+      point.z = p[2];
+      hull.points.push_back(point);
+    }
+    res.hulls.push_back(hull);
+  }
+  return true;
+}
+
+
+void Pass::processFromFile(int test_example){
+
+  // to allow ros connections to register
+  sleep(2);
+
+  std::string inFile;
+  std::string home_dir = ros::package::getPath("plane_seg_ros");
+  Eigen::Vector3f origin, lookDir;
+  if (test_example == 0){ // LIDAR example from Atlas during DRC
+    inFile = home_dir + "/data/terrain/tilted-steps.pcd";
+    origin <<0.248091, 0.012443, 1.806473;
+    lookDir <<0.837001, 0.019831, -0.546842;
+  }else if (test_example == 1){ // LIDAR example from Atlas during DRC
+    inFile = home_dir + "/data/terrain/terrain_med.pcd";
+    origin << -0.028862, -0.007466, 0.087855;
+    lookDir << 0.999890, -0.005120, -0.013947;
+  }else if (test_example == 2){ // LIDAR example from Atlas during DRC
+    inFile = home_dir + "/data/terrain/terrain_close_rect.pcd";
+    origin << -0.028775, -0.005776, 0.087898;
+    lookDir << 0.999956, -0.005003, 0.007958;
+  }else if (test_example == 3){ // RGBD (Realsense D435) example from ANYmal
+    inFile = home_dir + "/data/terrain/anymal/ori_entrance_stair_climb/06.pcd";
+    origin << -0.028775, -0.005776, 0.987898;
+    lookDir << 0.999956, -0.005003, 0.007958;
+  }else if (test_example == 4){ // Leica map
+    inFile = home_dir + "/data/leica/race_arenas/RACE_crossplaneramps_sub1cm_cropped_meshlab_icp.ply";
+    origin << -0.028775, -0.005776, 0.987898;
+    lookDir << 0.999956, -0.005003, 0.007958;
+  }else if (test_example == 5){ // Leica map
+    inFile = home_dir + "/data/leica/race_arenas/RACE_stepfield_sub1cm_cropped_meshlab_icp.ply";
+    origin << -0.028775, -0.005776, 0.987898;
+    lookDir << 0.999956, -0.005003, 0.007958;
+  }
+
+  std::cout << "\nProcessing test example " << test_example << "\n";
+  std::cout << inFile << "\n";
+
+  // the maps are static, their normals only need to be computed once
+  normals_cache_dir_ = cache_normals_ ? inFile.substr(0, inFile.find_last_of('/')) : "";
+
+  // the binary copy next to the original file is mapped instead of parsed,
+  // unless the original file changed since it was written
+  std::string cacheFile = inFile.substr(0, inFile.find_last_of('.')) + ".psc";
+  planeseg::MappedCloud mappedCloud;
+  if (isCacheFresh(cacheFile, inFile) && mappedCloud.open(cacheFile)){
+    std::cout << "readpsc\n";
+    processMappedCloud(mappedCloud, origin, lookDir);
+    return;
+  }
+
+  std::size_t found_ply = inFile.find(".ply");
+  std::size_t found_pcd = inFile.find(".pcd");
+
+  planeseg::LabeledCloud::Ptr inCloud(new planeseg::LabeledCloud());
+  if (found_ply!=std::string::npos){
+    std::cout << "readply\n";
+    pcl::io::loadPLYFile(inFile, *inCloud);
+  }else if (found_pcd!=std::string::npos){
+    std::cout << "readpcd\n";
+    pcl::io::loadPCDFile(inFile, *inCloud);
+  }else{
+    std::cout << "extension not understood\n";
+    return;
+  }
+  if (!planeseg::writeCloudFile(cacheFile, *inCloud, origin, lookDir)){
+    std::cout << "could not write " << cacheFile << "\n";
+  }
+  // tiling works on the mapped copy, the parsed cloud is released first
+  // (the conversion itself still holds the whole map once)
+  if ((tile_size_ > 0) && mappedCloud.open(cacheFile)){
+    inCloud.reset();
+    processMappedCloud(mappedCloud, origin, lookDir);
+    return;
+  }
+
+  processCloud(inCloud, origin, lookDir);
+}
+
+
+void Pass::processCloud(planeseg::LabeledCloud::Ptr& inCloud, Eigen::Vector3f origin, Eigen::Vector3f lookDir, bool downsample){
+
+  planeseg::BlockFitter fitter;
+  configureFitter(fitter, origin, lookDir);
+  if (!downsample){
+    fitter.setDownsampleResolution(0);
+  }
+  fitter.setCloud(inCloud);
+  result_ = fitter.go();
+  publishLookPose(origin, lookDir);
+
+  // republishing the input doubles the outgoing bandwidth, only do it when asked and listened to
+  if (publish_received_cloud_ && (received_cloud_pub_.getNumSubscribers() > 0)){
+    sensor_msgs::PointCloud2::Ptr output(new sensor_msgs::PointCloud2);
+    pcl::toROSMsg(*inCloud, *output);
+    output->header.stamp = ros::Time(0, 0);
+    output->header.frame_id = "odom";
+    received_cloud_pub_.publish(output);
+  }
+
+  //printResultAsJson();
+  publishResult();
+}
+
+
+// the mapped points are not republished, there is no PCL cloud to convert
+void Pass::processMappedCloud(const planeseg::MappedCloud& inCloud, Eigen::Vector3f origin, Eigen::Vector3f lookDir){
+
+  planeseg::BlockFitter fitter;
+  configureFitter(fitter, origin, lookDir);
+  if (tile_size_ > 0){
+    // large maps are split into tiles, only a few of them are in memory at once
+    planeseg::TiledBlockFitter tiledFitter;
+    tiledFitter.setFitter(fitter);
+    tiledFitter.setTileSize(tile_size_);
+    result_ = tiledFitter.go(inCloud);
+  }else{
+    fitter.setCloud(inCloud.x(), inCloud.y(), inCloud.z(), inCloud.size());
+    result_ = fitter.go();
+  }
+  publishLookPose(origin, lookDir);
+  publishResult();
+}
+
+
+void Pass::configureFitter(planeseg::BlockFitter& fitter, Eigen::Vector3f origin, Eigen::Vector3f lookDir){
+
+  fitter.setSensorPose(origin, lookDir);
+  fitter.setDebug(false); // MFALLON modification
+  fitter.setRemoveGround(false); // MFALLON modification from default
+
+  // this was 5 for LIDAR. changing to 10 really improved elevation map segmentation
+  // I think its because the RGB-D map can be curved
+  fitter.setMaxAngleOfPlaneSegmenter(10);
+  fitter.setCacheDirectory(normals_cache_dir_);
+}
+
+
+void Pass::publishLookPose(Eigen::Vector3f origin, Eigen::Vector3f lookDir){
+
+  Eigen::Vector3f rz = lookDir;
+  Eigen::Vector3f rx = rz.cross(Eigen::Vector3f::UnitZ());
+  Eigen::Vector3f ry = rz.cross(rx);
+  Eigen::Matrix3f rotation;
+  rotation.col(0) = rx.normalized();
+  rotation.col(1) = ry.normalized();
+  rotation.col(2) = rz.normalized();
+  Eigen::Isometry3f pose = Eigen::Isometry3f::Identity();
+  pose.linear() = rotation;
+  pose.translation() = origin;
+  Eigen::Isometry3d pose_d = pose.cast<double>();
+
+  geometry_msgs::PoseStamped msg;
+  msg.header.stamp = ros::Time(0, 0);
+  msg.header.frame_id = "odom";
+  tf::poseEigenToMsg(pose_d, msg.pose);
+  look_pose_pub_.publish(msg);
+}
+
+
+void Pass::printResultAsJson(){
+  std::string json;
+
+  for (int i = 0; i < (int)result_.mBlocks.size(); ++i) {
+    const auto& block = result_.mBlocks[i];
+    std::string dimensionString = vecToStr(block.mSize);
+    std::string positionString = vecToStr(block.mPose.translation());
+    std::string quaternionString = rotToStr(block.mPose.rotation());
+    Eigen::Vector3f color(0.5, 0.4, 0.5);
+    std::string colorString = vecToStr(color);
+    float alpha = 1.0;
+    std::string uuid = "0_" + std::to_string(i+1);
+    
+    json += "    \"" + uuid + "\": {\n";
+    json += "      \"classname\": \"BoxAffordanceItem\",\n";
+    json += "      \"pose\": [[" + positionString + "], [" +
+      quaternionString + "]],\n";
+    json += "      \"uuid\": \"" + uuid + "\",\n";
+    json += "      \"Dimensions\": [" + dimensionString + "],\n";
+    json += "      \"Color\": [" + colorString + "],\n";
+    json += "      \"Alpha\": " + std::to_string(alpha) + ",\n";
+    json += "      \"Name\": \" mNamePrefix " +
+      std::to_string(i) + "\"\n";
+    json += "    },\n";
+
+  }
+
+  std::cout << json << "\n";
+}
+
+
+void Pass::publishResult(){
+  publishPlanes();
+
+  // the visualisation is optional and rate limited
+  if (!publish_markers_){
+    return;
+  }
+  ros::Time now = ros::Time::now();
+  if ((marker_rate_ > 0) && ((now - last_marker_time_).toSec() < 1.0/marker_rate_)){
+    return;
+  }
+  last_marker_time_ = now;
+
+  // convert result to a vector of point clouds
+  std::vector< pcl::PointCloud<pcl::PointXYZ>::Ptr > cloud_ptrs;
+  for (size_t i=0; i<result_.mBlocks.size(); ++i){
+    pcl::PointCloud<pcl::PointXYZ> cloud;
+    const auto& block = result_.mBlocks[i];
+    for (size_t j =0; j < block.mHull.size(); ++j){
+      pcl::PointXYZ pt;
+      pt.x =block.mHull[j](0);
+      pt.y =block.mHull[j](1);
+      pt.z =block.mHull[j](2);
+      cloud.points.push_back(pt);
+    }
+    cloud.height = cloud.points.size();
+    cloud.width = 1;
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_ptr;
+    cloud_ptr = cloud.makeShared();
+    cloud_ptrs.push_back(cloud_ptr);
+  }
+
+  publishHullsAsCloud(cloud_ptrs, 0, 0);
+  publishHullsAsMarkers(cloud_ptrs, 0, 0);
+
+  //pcl::PCDWriter pcd_writer_;
+  //pcd_writer_.write<pcl::PointXYZ> ("/home/mfallon/out.pcd", cloud, false);
+  //std::cout << "blocks: " << result_.mBlocks.size() << " blocks\n";
+  //std::cout << "cloud: " << cloud.points.size() << " pts\n";
+}
+
+
+// the planes with their persistent ids, all of them or only the changes
+void Pass::publishPlanes(){
+  planes_ = plane_tracker_.update(result_.mBlocks);
+  const std::vector<planeseg::PlaneTracker::Plane>& planes = planes_;
+
+  // in delta mode a full message is still sent now and then for late subscribers
+  bool full = !publish_delta_ || (delta_keyframe_interval_ <= 1) ||
+              (planes_msg_count_ % delta_keyframe_interval_ == 0);
+  ++planes_msg_count_;
+
+  plane_seg_ros::PlaneArray::Ptr msg(new plane_seg_ros::PlaneArray);
+  msg->header.stamp = ros::Time(0, 0);
+  msg->header.frame_id = "odom";
+  msg->delta = !full;
+  for (const auto& plane : planes){
+    if (full && (plane.mStatus == planeseg::PlaneTracker::Removed)){
+      continue;
+    }
+    if (!full && (plane.mStatus == planeseg::PlaneTracker::Unchanged)){
+      continue;
+    }
+    plane_seg_ros::Plane plane_msg;
+    plane_msg.id = plane.mId;
+    switch (plane.mStatus){
+      case planeseg::PlaneTracker::Added: plane_msg.status = plane_seg_ros::Plane::ADDED; break;
+      case planeseg::PlaneTracker::Changed: plane_msg.status = plane_seg_ros::Plane::CHANGED; break;
+      case planeseg::PlaneTracker::Unchanged: plane_msg.status = plane_seg_ros::Plane::UNCHANGED; break;
+      case planeseg::PlaneTracker::Removed: plane_msg.status = plane_seg_ros::Plane::REMOVED; break;
+    }
+    for (int k = 0; k < 4; ++k){
+      plane_msg.coefficients[k] = plane.mPlane[k];
+    }
+    for (const auto& p : plane.mHull){
+      geometry_msgs::Point32 point;
+      point.x = p[0];
+      point.y = p[1];
+      point.z = p[2];
+      plane_msg.polygon.push_back(point);
+    }
+    msg->planes.push_back(plane_msg);
+  }
+
+  // an empty delta carries no information
+  if (full || !msg->planes.empty()){
+    planes_pub_.publish(msg);
+  }
+}
+
+
+// combine the individual clouds into one, with a different each
+void Pass::publishHullsAsCloud(std::vector< pcl::PointCloud<pcl::PointXYZ>::Ptr > cloud_ptrs,
+                                 int secs, int nsecs){
+
+
+  pcl::PointCloud<pcl::PointXYZRGB> combined_cloud;
+  for (size_t i=0; i<cloud_ptrs.size(); ++i){
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_rgb (new pcl::PointCloud<pcl::PointXYZRGB>);
+    pcl::copyPointCloud(*cloud_ptrs[i], *cloud_rgb);
+
+    int nColor = i % (colors_.size()/3);
+    double r = colors_[nColor*3]*255.0;
+    double g = colors_[nColor*3+1]*255.0;
+    double b = colors_[nColor*3+2]*255.0;
+    for (size_t j = 0; j < cloud_rgb->points.size (); j++){
+        cloud_rgb->points[j].r = r;
+        cloud_rgb->points[j].g = g;
+        cloud_rgb->points[j].b = b;
+    }
+    combined_cloud += *cloud_rgb;
+  }
+
+  // published by pointer so that nodelets in the same manager receive it without a copy
+  sensor_msgs::PointCloud2::Ptr output(new sensor_msgs::PointCloud2);
+  pcl::toROSMsg(combined_cloud, *output);
+
+  output->header.stamp = ros::Time(secs, nsecs);
+  output->header.frame_id = "odom";
+  hull_cloud_pub_.publish(output);
+
+}
+
+
+void Pass::publishHullsAsMarkers(std::vector< pcl::PointCloud<pcl::PointXYZ>::Ptr > cloud_ptrs,
+                                 int secs, int nsecs){
+  geometry_msgs::Point point;
+  std_msgs::ColorRGBA point_color;
+  visualization_msgs::Marker marker;
+  std::string frameID;
+
+  // define markers
+  marker.header.frame_id = "odom";
+  marker.header.stamp = ros::Time(secs, nsecs);
+  marker.ns = "hull lines";
+  marker.id = 0;
+  marker.type = visualization_msgs::Marker::LINE_LIST; //visualization_msgs::Marker::POINTS;
+  marker.action = visualization_msgs::Marker::ADD;
+  marker.pose.position.x = 0;
+  marker.pose.position.y = 0;
+  marker.pose.position.z = 0;
+  marker.pose.orientation.x = 0.0;
+  marker.pose.orientation.y = 0.0;
+  marker.pose.orientation.z = 0.0;
+  marker.pose.orientation.w = 1.0;
+  marker.scale.x = 0.03;
+  marker.scale.y = 0.03;
+  marker.scale.z = 0.03;
+  marker.color.a = 1.0;
+
+  for (size_t i = 0; i < cloud_ptrs.size (); i++){
+
+    int nColor = i % (colors_.size()/3);
+    double r = colors_[nColor*3]*255.0;
+    double g = colors_[nColor*3+1]*255.0;
+    double b = colors_[nColor*3+2]*255.0;
+
+    for (size_t j = 1; j < cloud_ptrs[i]->points.size (); j++){
+      point.x = cloud_ptrs[i]->points[j-1].x;
+      point.y = cloud_ptrs[i]->points[j-1].y;
+      point.z = cloud_ptrs[i]->points[j-1].z;
+      point_color.r = r;
+      point_color.g = g;
+      point_color.b = b;
+      point_color.a = 1.0;
+      marker.colors.push_back(point_color);
+      marker.points.push_back(point);
+
+      //
+      point.x = cloud_ptrs[i]->points[j].x;
+      point.y = cloud_ptrs[i]->points[j].y;
+      point.z = cloud_ptrs[i]->points[j].z;
+      point_color.r = r;
+      point_color.g = g;
+      point_color.b = b;
+      point_color.a = 1.0;
+      marker.colors.push_back(point_color);
+      marker.points.push_back(point);
+    }
+
+    // start to end line:
+    point.x = cloud_ptrs[i]->points[0].x;
+    point.y = cloud_ptrs[i]->points[0].y;
+    point.z = cloud_ptrs[i]->points[0].z;
+    point_color.r = r;
+    point_color.g = g;
+    point_color.b = b;
+    point_color.a = 1.0;
+    marker.colors.push_back(point_color);
+    marker.points.push_back(point);
+
+    point.x = cloud_ptrs[i]->points[ cloud_ptrs[i]->points.size()-1 ].x;
+    point.y = cloud_ptrs[i]->points[ cloud_ptrs[i]->points.size()-1 ].y;
+    point.z = cloud_ptrs[i]->points[ cloud_ptrs[i]->points.size()-1 ].z;
+    point_color.r = r;
+    point_color.g = g;
+    point_color.b = b;
+    point_color.a = 1.0;
+    marker.colors.push_back(point_color);
+    marker.points.push_back(point);
+  }
+  marker.frame_locked = true;
+  hull_markers_pub_.publish(marker);
+}
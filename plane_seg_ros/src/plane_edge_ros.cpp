@@ -0,0 +1,125 @@
+#include <functional>
+#include <thread>
+
+#include <ros/ros.h>
+#include <ros/console.h>
+
+#include <pcl/console/print.h>
+
+#include <grid_map_msgs/GridMap.h>
+#include <grid_map_ros/GridMapRosConverter.hpp>
+
+#include "plane_seg_ros/Pass.hpp"
+#include "edge_detection_ros/edge_detection_ros.h"
+#include "edge_detection/plane_edge_extractor.h"
+
+
+// all the blocks are converted, PlaneEdgeExtractor only keeps the horizontal ones
+std::vector<edge_detection::PlanarSegment> convertBlocksToSegments(const planeseg::BlockFitter::Result& result){
+  std::vector<edge_detection::PlanarSegment> segments;
+  for (size_t i = 0; i < result.mBlocks.size(); ++i){
+    const auto& block = result.mBlocks[i];
+    if (block.mHull.empty()){
+      continue;
+    }
+    edge_detection::PlanarSegment segment;
+    Eigen::Vector3d normal = block.mPose.rotation().col(2).cast<double>();
+    segment.plane << normal, -normal.dot(block.mHull[0].cast<double>());
+    for (size_t j = 0; j < block.mHull.size(); ++j){
+      segment.hull.push_back(block.mHull[j].head<2>().cast<double>());
+    }
+    segments.push_back(segment);
+  }
+  return segments;
+}
+
+
+// Runs the plane segmentation and the edge detection on the same elevation map,
+// which is decoded once per message and shared read-only by both.
+class PlaneEdgeRos{
+  public:
+    PlaneEdgeRos(ros::NodeHandle& node, ros::NodeHandle& private_node);
+
+    void elevationMapCallback(const grid_map_msgs::GridMap& msg);
+
+  private:
+    std::string frame_name_;
+    Pass pass_;
+    edge_detection::EdgeDetectionRos edge_detection_;
+    edge_detection::PlaneEdgeExtractor plane_edges_;
+    ros::Subscriber grid_map_sub_;
+    bool use_segment_heights_;
+    bool edges_from_planes_;
+};
+
+PlaneEdgeRos::PlaneEdgeRos(ros::NodeHandle& node, ros::NodeHandle& private_node):
+    frame_name_("point_cloud_odom"),
+    pass_(private_node, false),
+    edge_detection_(node, frame_name_, 0.4, 0.02, false){
+
+  // with segment heights or edges from the planes the edges wait for the
+  // segmentation of the same map, otherwise both run concurrently
+  std::string edge_source;
+  private_node.param("use_segment_heights", use_segment_heights_, false);
+  private_node.param<std::string>("edge_source", edge_source, "image");
+  edges_from_planes_ = (edge_source == "planes");
+  std::cout << "use_segment_heights: " << use_segment_heights_ << "\n";
+  std::cout << "edge_source: " << edge_source << "\n";
+
+  if (edges_from_planes_ || use_segment_heights_){
+    edge_detection_.setStepHeightProvider(
+        std::bind(&edge_detection::PlaneEdgeExtractor::getStepHeight, &plane_edges_,
+                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
+                  std::placeholders::_4, std::placeholders::_5));
+  }
+
+  grid_map_sub_ = node.subscribe("/elevation_mapping/elevation_map", 1,
+                                    &PlaneEdgeRos::elevationMapCallback, this);
+}
+
+void PlaneEdgeRos::elevationMapCallback(const grid_map_msgs::GridMap& msg){
+  std::shared_ptr<grid_map::GridMap> decoded = std::make_shared<grid_map::GridMap>();
+  grid_map::GridMapRosConverter::fromMessage(msg, *decoded);
+  std::shared_ptr<const grid_map::GridMap> map = decoded;
+
+  if (edges_from_planes_){
+    // the image pipeline is skipped: the edges are the boundaries between the segments
+    pass_.processGridMap(*map);
+    plane_edges_.setSegments(convertBlocksToSegments(pass_.getResult()));
+    // the heights of the candidates are oriented along the heading used by EdgeDetection for this map
+    std::vector<edge_detection::EdgeContainer> candidates;
+    plane_edges_.extract(edge_detection_.getRobotState(), candidates);
+    edge_detection_.update(map, candidates);
+    return;
+  }
+
+  if (use_segment_heights_){
+    pass_.processGridMap(*map);
+    plane_edges_.setSegments(convertBlocksToSegments(pass_.getResult()));
+    edge_detection_.update(map);
+    return;
+  }
+
+  std::thread edge_thread([this, &map](){ edge_detection_.update(map); });
+  pass_.processGridMap(*map);
+  edge_thread.join();
+}
+
+
+int main( int argc, char** argv ){
+  // Turn off warning message about labels
+  pcl::console::setVerbosityLevel(pcl::console::L_ALWAYS);
+
+  ros::init(argc, argv, "plane_edge");
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+  std::unique_ptr<PlaneEdgeRos> app = std::make_unique<PlaneEdgeRos>(nh, private_nh);
+
+  ROS_INFO_STREAM("plane_edge ros ready");
+  ROS_INFO_STREAM("=============================");
+
+  // single threaded: the pose callbacks never run while a map is processed
+  ros::spin();
+
+  return 1;
+}
@@ -0,0 +1,31 @@
+#include <memory>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <pcl/console/print.h>
+
+#include "plane_seg_ros/Pass.hpp"
+
+
+namespace plane_seg_ros{
+
+// Runs Pass inside a nodelet manager: the clouds and elevation maps coming
+// from nodelets in the same manager are received by pointer, without being
+// serialised. Set ~publish_received_cloud to false to stop republishing the input.
+class PlaneSegNodelet : public nodelet::Nodelet{
+  private:
+    void onInit() override{
+      // Turn off warning message about labels
+      pcl::console::setVerbosityLevel(pcl::console::L_ALWAYS);
+
+      pass_.reset(new Pass(getPrivateNodeHandle()));
+      NODELET_INFO_STREAM("plane_seg nodelet ready");
+    }
+
+    std::unique_ptr<Pass> pass_;
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(plane_seg_ros::PlaneSegNodelet, nodelet::Nodelet)